@@ -0,0 +1,36 @@
+# Turns a file into a C array, so the game needs no disk read to get it:
+#   cmake -DINPUT=<file> -DOUTPUT=<file.c> -DNAME=<symbol> -P EmbedAsset.cmake
+# Defines <symbol>[] and <symbol>_size. A missing or empty input is an error.
+
+if (NOT EXISTS "${INPUT}")
+    message (FATAL_ERROR "${INPUT} not found, nothing to embed for ${NAME}")
+endif ()
+file (READ "${INPUT}" hex HEX)
+if (hex STREQUAL "")
+    message (FATAL_ERROR "${INPUT} is empty, nothing to embed for ${NAME}")
+endif ()
+
+string (LENGTH "${hex}" hex_length)
+math (EXPR size "${hex_length} / 2")
+
+# 16 bytes to a line (CMake regexes have no {n})
+string (REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," bytes "${hex}")
+set (line_pattern "")
+foreach (i RANGE 1 16)
+    set (line_pattern "${line_pattern}0x[0-9a-f][0-9a-f],")
+endforeach ()
+string (REGEX REPLACE "(${line_pattern})" "\\1\n    " bytes "${bytes}")
+
+file (WRITE "${OUTPUT}.tmp"
+    "/* Generated by CMake/EmbedAsset.cmake from ${INPUT}, do not edit */\n"
+    "\n"
+    "#include <stdint.h>\n"
+    "\n"
+    "const uint8_t ${NAME}[] = {\n"
+    "    ${bytes}\n"
+    "};\n"
+    "const uint32_t ${NAME}_size = ${size};\n")
+
+# Only touches the output when it changed, so nothing rebuilds needlessly
+execute_process (COMMAND ${CMAKE_COMMAND} -E copy_if_different "${OUTPUT}.tmp" "${OUTPUT}")
+file (REMOVE "${OUTPUT}.tmp")
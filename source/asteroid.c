@@ -34,9 +34,71 @@
 #define WAS_USING_ASTEROID
 #define WAS_USING_BLAST
 #define WAS_USING_SHIP
+#define WAS_USING_PARTICLE
+#define WAS_USING_RENDER
 #include "wasteroids.h"
 
 
+/*=========================================
+=            Local definitions            =
+=========================================*/
+
+/**
+ * Outline meshes from full detail down to a single point, as indices into
+ * the vertices of the asteroid's shape
+ */
+typedef struct {
+    int32 count;
+    int32 index[NUM_VERTICES];
+} AsteroidLod;
+
+static const AsteroidLod LODS[] = {
+    { 12, { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 } },
+    { 8,  { 0, 1, 3, 4, 6, 7, 9, 10 } },
+    { 4,  { 0, 3, 6, 9 } },
+    { 1,  { 0 } }
+};
+#define NUM_LODS ((int32)(sizeof(LODS) / sizeof(LODS[0])))
+
+/**
+ * On-screen radius, in pixels, from which each mesh gets used
+ */
+static const float LOD_MIN_RADIUS[] = { 10.0f, 6.0f, 3.0f, 0.0f };
+
+/**
+ * Asteroids are binned on a coarse grid while drawing. Those sharing a
+ * cell with this many others get one step less detail.
+ */
+#define LOD_GRID_WIDTH 8
+#define LOD_GRID_HEIGHT 6
+#define LOD_CROWDED 8
+
+/**
+ * Most detailed mesh allowed, set by the quality governor
+ */
+static int32 lod_min = 0;
+
+/**
+ * Outline radius range of generated shapes, relative to ASTEROID_DIMENSION,
+ * and how far each vertex may stray from its even angular spacing
+ */
+static const float SHAPE_MIN_RADIUS = 0.7f;
+static const float SHAPE_MAX_RADIUS = 1.25f;
+static const float SHAPE_ANGLE_JITTER = 0.35f;
+
+/**
+ * Fixed seed, so every build and every peer gets the same library
+ */
+#define SHAPE_SEED 0x5eed1e55u
+
+/**
+ * The list gets re-sorted once more than one in this many neighbours are
+ * out of Z-order
+ */
+#define SORT_DISORDER 8
+
+/*=====  End of Local definitions  ======*/
+
 /**
  * @brief      Creates a new asteroid
  *
@@ -47,11 +109,15 @@
  * @param[in]  alive      The alive
  * @param[in]  color      The color
  *
- * @return     Pointer to new asteroid
+ * @return     Pointer to new asteroid, or NULL if the asteroid list is full
  */
 Asteroid * asteroid_make_new(float x, float y, float direction, float scale, float speed,
                        bool alive, ALLEGRO_COLOR color, float thickness) {
     Asteroid * newAsteroid;
+
+    if (num_asteroids >= ASTEROID_MAX) {
+        return NULL;
+    }
     newAsteroid = (Asteroid *) malloc(sizeof(Asteroid));
 
     // Value checking
@@ -60,9 +126,12 @@ Asteroid * asteroid_make_new(float x, float y, float direction, float scale, flo
     newAsteroid->direction = direction;
     newAsteroid->scale = scale;
     newAsteroid->speed = speed;
+    sim_place(&newAsteroid->motion, x, y);
     newAsteroid->alive = alive;
     newAsteroid->color = color;
     newAsteroid->thickness = thickness;
+    newAsteroid->shape = 0;
+    newAsteroid->id = 0;
 
     // Add new asteroid to asteroid list
     asteroids[num_asteroids] = newAsteroid;
@@ -79,7 +148,7 @@ Asteroid * asteroid_make_new(float x, float y, float direction, float scale, flo
  * @param[in]  direction  The direction
  * @param[in]  scale      The scale
  *
- * @return     Pointer to new asteroid
+ * @return     Pointer to new asteroid, or NULL if the asteroid list is full
  */
 Asteroid * asteroid_make_new_default(float x, float y, float direction, float scale) {
     Asteroid * newAsteroid;
@@ -95,13 +164,35 @@ Asteroid * asteroid_make_new_default(float x, float y, float direction, float sc
 }
 
 /**
- * @brief      Draws asteroid on screen
+ * @brief      Picks the outline mesh for an asteroid from its on-screen size
+ *
+ * @param      asteroid  The asteroid
+ *
+ * @return     Index on LODS
+ */
+static int32 asteroid_select_lod(Asteroid *asteroid) {
+    // World units to pixels, as drawn into the render target
+    float radius = asteroid->scale * ASTEROID_DIMENSION * render_get_scale();
+    int32 lod = 0;
+
+    while (lod < NUM_LODS - 1 && radius < LOD_MIN_RADIUS[lod]) {
+        ++lod;
+    }
+
+    return lod > lod_min ? lod : lod_min;
+}
+
+/**
+ * @brief      Draws asteroid on screen with the given outline mesh
  *
  * @param      asteroid  The asteroid
+ * @param[in]  lod       Index on LODS
  *
  * @return     0 for success or anything else for error
  */
-int8 asteroid_draw(Asteroid *asteroid) {
+static int8 asteroid_draw_lod(Asteroid *asteroid, int32 lod) {
+    const AsteroidLod *mesh = &LODS[lod];
+    const float *vertices = asteroid_shapes[asteroid->shape].vertices;
     int32 i;
 
     ALLEGRO_TRANSFORM transform;
@@ -112,6 +203,12 @@ int8 asteroid_draw(Asteroid *asteroid) {
         return -1;
     }
 
+    // Too small or too far down the list for an outline
+    if (mesh->count == 1) {
+        al_draw_pixel(asteroid->x, asteroid->y, asteroid->color);
+        return 0;
+    }
+
     // Saves current transform state
     prevTransform = al_get_current_transform();
 
@@ -120,13 +217,17 @@ int8 asteroid_draw(Asteroid *asteroid) {
     al_scale_transform(&transform, asteroid->scale, asteroid->scale);
     al_rotate_transform(&transform, -asteroid->direction + (float)ALLEGRO_PI / 2.0f);
     al_translate_transform(&transform, asteroid->x, asteroid->y);
+    if (prevTransform != NULL) {
+        al_compose_transform(&transform, prevTransform);
+    }
     al_use_transform(&transform);
 
     // Draws the asteroid
-    for (i = 0; i < NUM_VERTICES - 1; ++i) {
-        al_draw_line(VERTICES[2*i], VERTICES[2*i + 1], VERTICES[2*(i+1)], VERTICES[2*(i+1) + 1], asteroid->color, asteroid->thickness);
+    for (i = 0; i < mesh->count; ++i) {
+        int32 a = mesh->index[i];
+        int32 b = mesh->index[(i + 1) % mesh->count];
+        al_draw_line(vertices[2*a], vertices[2*a + 1], vertices[2*b], vertices[2*b + 1], asteroid->color, RENDER_THICKNESS(asteroid->thickness));
     }
-    al_draw_line(VERTICES[0], VERTICES[1], VERTICES[2*i], VERTICES[2*i + 1], asteroid->color, asteroid->thickness);
 
     // Reloads previous transform state
     if (prevTransform != NULL) {
@@ -136,14 +237,54 @@ int8 asteroid_draw(Asteroid *asteroid) {
     return 0;
 }
 
+/**
+ * @brief      Draws asteroid on screen
+ *
+ * @param      asteroid  The asteroid
+ *
+ * @return     0 for success or anything else for error
+ */
+int8 asteroid_draw(Asteroid *asteroid) {
+    return asteroid_draw_lod(asteroid, asteroid_select_lod(asteroid));
+}
+
+/**
+ * @brief      Gets the LOD grid cell an asteroid is in
+ *
+ * @param      asteroid  The asteroid
+ *
+ * @return     Cell index
+ */
+static int32 asteroid_lod_cell(Asteroid *asteroid) {
+    int32 cx = (int32)(asteroid->x * world_bounds.inv_width * LOD_GRID_WIDTH);
+    int32 cy = (int32)(asteroid->y * world_bounds.inv_height * LOD_GRID_HEIGHT);
+
+    cx = cx < 0 ? 0 : (cx >= LOD_GRID_WIDTH ? LOD_GRID_WIDTH - 1 : cx);
+    cy = cy < 0 ? 0 : (cy >= LOD_GRID_HEIGHT ? LOD_GRID_HEIGHT - 1 : cy);
+
+    return cy * LOD_GRID_WIDTH + cx;
+}
+
 /**
  * @brief      Draws all active asteroids to screen
  */
 void asteroid_draw_all() {
+    int32 crowd[LOD_GRID_WIDTH * LOD_GRID_HEIGHT] = { 0 };
     int32 i;
 
     for (i = 0; i < num_asteroids; ++i) {
-        asteroid_draw(asteroids[i]);
+        ++crowd[asteroid_lod_cell(asteroids[i])];
+    }
+
+    for (i = 0; i < num_asteroids; ++i) {
+        int32 lod = asteroid_select_lod(asteroids[i]);
+
+        // Crowded areas lose a step, but only the smallest become points
+        if (crowd[asteroid_lod_cell(asteroids[i])] > LOD_CROWDED && lod < NUM_LODS - 2) {
+            ++lod;
+        }
+
+        asteroid_draw_lod(asteroids[i], lod);
     }
 }
 
@@ -157,10 +298,12 @@ void asteroid_draw_all() {
  * @param[out] y2        Address to bottom right corner's y-coordinate
  */
 void asteroid_get_corners(Asteroid *asteroid, float *x1, float *y1, float *x2, float *y2) {
-    *x1 = asteroid->x - asteroid->scale * ASTEROID_DIMENSION;
-    *y1 = asteroid->y - asteroid->scale * ASTEROID_DIMENSION;
-    *x2 = asteroid->x + asteroid->scale * ASTEROID_DIMENSION;
-    *y2 = asteroid->y + asteroid->scale * ASTEROID_DIMENSION;
+    float radius = asteroid->scale * asteroid_shapes[asteroid->shape].radius;
+
+    *x1 = asteroid->x - radius;
+    *y1 = asteroid->y - radius;
+    *x2 = asteroid->x + radius;
+    *y2 = asteroid->y + radius;
 }
 
 /**
@@ -216,8 +359,6 @@ void asteroid_delete_all() {
 void asteroid_move(Asteroid *asteroid) {
     float x_center = asteroid->x;
     float y_center = asteroid->y;
-    float dx;
-    float dy;
 
     int32 width;
     int32 height;
@@ -229,8 +370,8 @@ void asteroid_move(Asteroid *asteroid) {
     }
 
     // If it crosses the border, make it appears on the other side
-    width = al_get_display_width(screen);
-    height = al_get_display_height(screen);
+    width = world_bounds.width;
+    height = world_bounds.height;
     if (x_center > width) {
         asteroid->x = 0;
     }
@@ -245,11 +386,11 @@ void asteroid_move(Asteroid *asteroid) {
         asteroid->y = height;
     }
 
-    dx = asteroid->speed * (float)cos(asteroid->direction);
-    dy = - asteroid->speed * (float)sin(asteroid->direction);
+    if (asteroid->x != x_center || asteroid->y != y_center) {
+        sim_place(&asteroid->motion, asteroid->x, asteroid->y);
+    }
 
-    asteroid->x += dx;
-    asteroid->y += dy;
+    sim_advance(&asteroid->motion, &asteroid->x, &asteroid->y, asteroid->speed * sim_dt, asteroid->direction);
 }
 
 /**
@@ -275,16 +416,25 @@ void asteroid_populate(int32 n) {
     float y;
     float direction;
     float scale;
+    Asteroid *asteroid;
 
     for (i = 0; i < n; ++i) {
-        // Randomly populates
-        x = rand() % al_get_display_width(screen);
-        y = rand() % al_get_display_height(screen);
-        direction = MAX_ANGLE * ((rand() % 100) / 100.0f);
-        scale = 1.0f + ((rand() % 11) / 5.0f);
+        // Randomly populates, each asteroid from its own stream
+        uint32 id = sim_child_id(sim_tick, (uint32)i);
+        SimStream stream = sim_stream(id);
+
+        x = sim_stream_next(&stream) % world_bounds.width;
+        y = sim_stream_next(&stream) % world_bounds.height;
+        direction = MAX_ANGLE * ((sim_stream_next(&stream) % 100) / 100.0f);
+        scale = 1.0f + ((sim_stream_next(&stream) % 11) / 5.0f);
 
         // Make new asteroid
-        asteroid_make_new_default(x, y, direction, scale);
+        asteroid = asteroid_make_new_default(x, y, direction, scale);
+        if (!asteroid) {
+            break;
+        }
+        asteroid->shape = (uint8)(sim_stream_next(&stream) % ASTEROID_SHAPES);
+        asteroid->id = id;
     }
 }
 
@@ -297,9 +447,11 @@ void asteroid_populate(int32 n) {
  * @return     true if collision detected; false otherwise
  */
 bool asteroid_check_collision_on_blast(Asteroid *asteroid, Blast *blast) {
-    // Blast's end point
-    float x_blast;
-    float y_blast;
+    // Area the blast swept this tick
+    float bx1;
+    float by1;
+    float bx2;
+    float by2;
 
     // Asteroid's corners
     float x1;
@@ -308,16 +460,17 @@ bool asteroid_check_collision_on_blast(Asteroid *asteroid, Blast *blast) {
     float y2;
 
     // Gets coordinates
-    blast_get_end_point(blast, &x_blast, &y_blast);
+    blast_get_swept_segment(blast, &bx1, &by1, &bx2, &by2);
     asteroid_get_corners(asteroid, &x1, &y1, &x2, &y2);
 
-    // Checks for collision on both points of the blast (start and end points)
-    if (common_check_collision(x_blast, y_blast, x1, y1, x2, y2)
-            || common_check_collision(blast->x, blast->y, x1, y1, x2, y2)) {
-        return true;
+    // Boxes first, then the whole swept segment against the outline, so
+    // fast blasts can't skip over small asteroids between two ticks
+    if (fminf(bx1, bx2) > x2 || fmaxf(bx1, bx2) < x1
+            || fminf(by1, by2) > y2 || fmaxf(by1, by2) < y1) {
+        return false;
     }
 
-    return false;
+    return asteroid_intersects_segment(asteroid, bx1, by1, bx2, by2);
 }
 
 /**
@@ -326,10 +479,15 @@ bool asteroid_check_collision_on_blast(Asteroid *asteroid, Blast *blast) {
  * @param      asteroid  The asteroid
  */
 void asteroid_was_hit(Asteroid *asteroid) {
+    SimStream stream = sim_stream(asteroid->id);
+    Asteroid *child;
     float direction;
     float scale;
     float x;
     float y;
+    uint8 shape;
+
+    particle_emit_debris(asteroid->x, asteroid->y, asteroid->scale);
 
     // It's time to say goodbye...
     if (asteroid->scale <= 1) {
@@ -339,19 +497,30 @@ void asteroid_was_hit(Asteroid *asteroid) {
 
     // Otherwise...
     // It gives birth to two smaller children before going away... forever
+    // A full asteroid list skips the child; the stream is drawn the same either way
     // Child 1
-    direction = asteroid->direction + ((rand()%101)-50.0f)/100.0f; // Some randomness inserted
+    direction = asteroid->direction + ((sim_stream_next(&stream)%101)-50.0f)/100.0f; // Some randomness inserted
     scale = asteroid->scale / 2.0f;
-    x = asteroid->x + (rand()%100) - 50.0f;
-    y = asteroid->y + (rand()%100) - 50.0f;
-    asteroid_make_new_default(x, y, direction, scale);
+    x = asteroid->x + (sim_stream_next(&stream)%100) - 50.0f;
+    y = asteroid->y + (sim_stream_next(&stream)%100) - 50.0f;
+    shape = (uint8)(sim_stream_next(&stream) % ASTEROID_SHAPES);
+    child = asteroid_make_new_default(x, y, direction, scale);
+    if (child) {
+        child->shape = shape;
+        child->id = sim_child_id(asteroid->id, 1);
+    }
 
     // Child 2
-    direction = asteroid->direction + ((rand()%101)-50.0f)/100.0f; // Some randomness inserted
+    direction = asteroid->direction + ((sim_stream_next(&stream)%101)-50.0f)/100.0f; // Some randomness inserted
     scale = asteroid->scale / 2.0f;
-    x = asteroid->x + (rand()%100) - 50.0f;
-    y = asteroid->y + (rand()%100) - 50.0f;
-    asteroid_make_new_default(x, y, direction, scale);
+    x = asteroid->x + (sim_stream_next(&stream)%100) - 50.0f;
+    y = asteroid->y + (sim_stream_next(&stream)%100) - 50.0f;
+    shape = (uint8)(sim_stream_next(&stream) % ASTEROID_SHAPES);
+    child = asteroid_make_new_default(x, y, direction, scale);
+    if (child) {
+        child->shape = shape;
+        child->id = sim_child_id(asteroid->id, 2);
+    }
 
     asteroid_delete(asteroid);
 }
@@ -361,10 +530,10 @@ void asteroid_was_hit(Asteroid *asteroid) {
  *
  * @param      scale  The asteroid's scale
  *
- * @return     Speed value
+ * @return     Speed in pixels per second
  */
 float asteroid_calc_speed(float scale) {
-    return 5.0f - scale;
+    return 60.0f * (5.0f - scale);
 }
 
 /**
@@ -395,10 +564,350 @@ bool asteroid_check_collision_on_ship(Asteroid *asteroid, Ship *ship) {
 
     // Check for collision for each base point
     for (i = 0; i < 7; ++i) {
-        if (common_check_collision(x[i], y[i], x1, y1, x2, y2)) {
+        if (common_check_collision(x[i], y[i], x1, y1, x2, y2)
+                && asteroid_contains_point(asteroid, x[i], y[i])) {
             return true;
         }
     }    
 
     return false;
 }
+
+/**
+ * @brief      Caps how many outline vertices asteroids are drawn with
+ *
+ * @param[in]  n     Max number of vertices
+ */
+void asteroid_set_max_vertices(int32 n) {
+    lod_min = 0;
+    while (lod_min < NUM_LODS - 1 && LODS[lod_min].count > n) {
+        ++lod_min;
+    }
+}
+
+/**
+ * @brief      Checks if a fan piece of a shape is convex
+ *
+ * @param      vertices  Shape outline
+ * @param[in]  first     First outline vertex of the piece
+ * @param[in]  count     Number of outline vertices on the piece
+ *
+ * @return     true if convex; false otherwise
+ */
+static bool asteroid_piece_is_convex(const float *vertices, int32 first, int32 count) {
+    float px[NUM_VERTICES + 1];
+    float py[NUM_VERTICES + 1];
+    int32 n = count + 1;
+    int32 i;
+
+    // The origin closes the fan
+    px[0] = 0.0f;
+    py[0] = 0.0f;
+    for (i = 0; i < count; ++i) {
+        int32 v = (first + i) % NUM_VERTICES;
+        px[i + 1] = vertices[2*v];
+        py[i + 1] = vertices[2*v + 1];
+    }
+
+    // Every turn has to go the same way as the outline, which winds counterclockwise
+    for (i = 0; i < n; ++i) {
+        int32 a = i;
+        int32 b = (i + 1) % n;
+        int32 c = (i + 2) % n;
+        float cross = (px[b] - px[a]) * (py[c] - py[b]) - (py[b] - py[a]) * (px[c] - px[b]);
+
+        if (cross < 0.0f) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief      Builds the shape library. Must run once before any asteroid is created.
+ */
+void asteroid_shapes_init() {
+    uint32 seed = SHAPE_SEED;
+    int32 s;
+
+    for (s = 0; s < ASTEROID_SHAPES; ++s) {
+        AsteroidShape *shape = &asteroid_shapes[s];
+        int32 first;
+        int32 i;
+
+        shape->radius = 0.0f;
+        for (i = 0; i < NUM_VERTICES; ++i) {
+            float angle;
+            float radius;
+
+            seed = seed * 1664525u + 1013904223u;
+            angle = (i + SHAPE_ANGLE_JITTER * ((seed >> 8) / 16777216.0f - 0.5f))
+                    * MAX_ANGLE / NUM_VERTICES;
+            seed = seed * 1664525u + 1013904223u;
+            radius = ASTEROID_DIMENSION * (SHAPE_MIN_RADIUS + (SHAPE_MAX_RADIUS - SHAPE_MIN_RADIUS)
+                                           * ((seed >> 8) / 16777216.0f));
+
+            shape->vertices[2*i] = radius * sim_cos(angle);
+            shape->vertices[2*i + 1] = radius * sim_sin(angle);
+            if (radius > shape->radius) {
+                shape->radius = radius;
+            }
+        }
+
+        // Greedily grows each fan piece while it stays convex
+        shape->num_pieces = 0;
+        first = 0;
+        while (first < NUM_VERTICES) {
+            int32 count = 2;
+
+            while (first + count <= NUM_VERTICES
+                    && asteroid_piece_is_convex(shape->vertices, first, count + 1)) {
+                ++count;
+            }
+
+            shape->piece_first[shape->num_pieces++] = (uint8)first;
+            first += count - 1;
+        }
+    }
+}
+
+/**
+ * @brief      Moves a point from the world into an asteroid's shape space,
+ *             undoing the transform used to draw the asteroid
+ *
+ * @param      asteroid  The asteroid
+ * @param[in]  x         World x-coordinate
+ * @param[in]  y         World y-coordinate
+ * @param[out] px        Address to shape x-coordinate
+ * @param[out] py        Address to shape y-coordinate
+ */
+static void asteroid_to_shape_space(Asteroid *asteroid, float x, float y, float *px, float *py) {
+    float angle = -asteroid->direction + (float)ALLEGRO_PI / 2.0f;
+    float c = sim_cos(angle);
+    float s = sim_sin(angle);
+    float dx = x - asteroid->x;
+    float dy = y - asteroid->y;
+
+    *px = (dx * c + dy * s) / asteroid->scale;
+    *py = (-dx * s + dy * c) / asteroid->scale;
+}
+
+/**
+ * @brief      Checks if a point lies inside a shape, in the shape's own space
+ *
+ * @param      shape  The shape
+ * @param[in]  px     x-coordinate
+ * @param[in]  py     y-coordinate
+ *
+ * @return     true if inside; false otherwise
+ */
+static bool asteroid_shape_contains(const AsteroidShape *shape, float px, float py) {
+    int32 k;
+
+    for (k = 0; k < shape->num_pieces; ++k) {
+        int32 first = shape->piece_first[k];
+        int32 last = (k + 1 < shape->num_pieces) ? shape->piece_first[k + 1] : NUM_VERTICES;
+        float ax = 0.0f;
+        float ay = 0.0f;
+        bool inside = true;
+        int32 i;
+
+        // Walks the fan from the origin along the outline and back to the origin
+        for (i = first; i <= last + 1 && inside; ++i) {
+            float bx = 0.0f;
+            float by = 0.0f;
+
+            if (i <= last) {
+                bx = shape->vertices[2*(i % NUM_VERTICES)];
+                by = shape->vertices[2*(i % NUM_VERTICES) + 1];
+            }
+
+            inside = (bx - ax) * (py - ay) - (by - ay) * (px - ax) >= 0.0f;
+            ax = bx;
+            ay = by;
+        }
+
+        if (inside) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief      Checks if a point lies inside an asteroid's outline
+ *
+ * @param      asteroid  The asteroid
+ * @param[in]  x         x-coordinate
+ * @param[in]  y         y-coordinate
+ *
+ * @return     true if inside; false otherwise
+ */
+bool asteroid_contains_point(Asteroid *asteroid, float x, float y) {
+    const AsteroidShape *shape = &asteroid_shapes[asteroid->shape];
+    float dx = x - asteroid->x;
+    float dy = y - asteroid->y;
+    float px;
+    float py;
+
+    // Bounding circle first
+    if (dx*dx + dy*dy > asteroid->scale * asteroid->scale * shape->radius * shape->radius) {
+        return false;
+    }
+
+    asteroid_to_shape_space(asteroid, x, y, &px, &py);
+    return asteroid_shape_contains(shape, px, py);
+}
+
+/**
+ * @brief      Spreads the low 16 bits of a value over the even bits
+ *
+ * @param[in]  v     The value
+ *
+ * @return     Spread value
+ */
+static uint32 asteroid_spread_bits(uint32 v) {
+    v &= 0xffffu;
+    v = (v | (v << 8)) & 0x00ff00ffu;
+    v = (v | (v << 4)) & 0x0f0f0f0fu;
+    v = (v | (v << 2)) & 0x33333333u;
+    v = (v | (v << 1)) & 0x55555555u;
+    return v;
+}
+
+/**
+ * @brief      Gets the Morton (Z-order) code of an asteroid's position
+ *
+ * @param      asteroid  The asteroid
+ *
+ * @return     Morton code, 16 bits per axis
+ */
+static uint32 asteroid_morton_code(Asteroid *asteroid) {
+    float fx = asteroid->x * world_bounds.inv_width;
+    float fy = asteroid->y * world_bounds.inv_height;
+    uint32 x = (uint32)((fx < 0.0f ? 0.0f : (fx > 1.0f ? 1.0f : fx)) * 65535.0f);
+    uint32 y = (uint32)((fy < 0.0f ? 0.0f : (fy > 1.0f ? 1.0f : fy)) * 65535.0f);
+
+    return asteroid_spread_bits(x) | (asteroid_spread_bits(y) << 1);
+}
+
+/**
+ * @brief      Reorders the asteroid list by Morton code of position, so
+ *             asteroids close on screen are close on the list. Only sorts
+ *             once enough of the list went out of order; the sort is a
+ *             stable radix sort, and asteroids themselves never move.
+ */
+void asteroid_sort_spatial() {
+    uint32 keys[ASTEROID_MAX];
+    uint32 keys_tmp[ASTEROID_MAX];
+    Asteroid *tmp[ASTEROID_MAX];
+    int32 disorder = 0;
+    int32 shift;
+    int32 i;
+
+    for (i = 0; i < num_asteroids; ++i) {
+        keys[i] = asteroid_morton_code(asteroids[i]);
+        if (i > 0 && keys[i] < keys[i - 1]) {
+            ++disorder;
+        }
+    }
+
+    if (disorder * SORT_DISORDER <= num_asteroids) {
+        return;
+    }
+
+    // LSD radix sort, one byte per pass
+    for (shift = 0; shift < 32; shift += 8) {
+        int32 count[256] = { 0 };
+        int32 sum = 0;
+
+        for (i = 0; i < num_asteroids; ++i) {
+            ++count[(keys[i] >> shift) & 0xff];
+        }
+
+        // Every key has the same byte, nothing to do this pass
+        if (count[(keys[0] >> shift) & 0xff] == num_asteroids) {
+            continue;
+        }
+
+        for (i = 0; i < 256; ++i) {
+            int32 c = count[i];
+            count[i] = sum;
+            sum += c;
+        }
+
+        for (i = 0; i < num_asteroids; ++i) {
+            int32 dst = count[(keys[i] >> shift) & 0xff]++;
+            keys_tmp[dst] = keys[i];
+            tmp[dst] = asteroids[i];
+        }
+
+        memcpy(keys, keys_tmp, sizeof(uint32) * num_asteroids);
+        memcpy(asteroids, tmp, sizeof(Asteroid *) * num_asteroids);
+    }
+}
+
+/**
+ * @brief      Checks if a segment touches an asteroid: either it has an end
+ *             inside the outline or it crosses one of the outline's edges
+ *
+ * @param      asteroid  The asteroid
+ * @param[in]  x1        First end's x-coordinate
+ * @param[in]  y1        First end's y-coordinate
+ * @param[in]  x2        Second end's x-coordinate
+ * @param[in]  y2        Second end's y-coordinate
+ *
+ * @return     true if they touch; false otherwise
+ */
+bool asteroid_intersects_segment(Asteroid *asteroid, float x1, float y1, float x2, float y2) {
+    const AsteroidShape *shape = &asteroid_shapes[asteroid->shape];
+    float radius = asteroid->scale * shape->radius;
+    float ax;
+    float ay;
+    float bx;
+    float by;
+    float sx;
+    float sy;
+    float t;
+    int32 i;
+
+    // Bounding circle against the closest point of the segment
+    sx = x2 - x1;
+    sy = y2 - y1;
+    t = sx*sx + sy*sy;
+    t = (t > 0.0f) ? ((asteroid->x - x1) * sx + (asteroid->y - y1) * sy) / t : 0.0f;
+    t = (t < 0.0f) ? 0.0f : (t > 1.0f ? 1.0f : t);
+    sx = x1 + t * sx - asteroid->x;
+    sy = y1 + t * sy - asteroid->y;
+    if (sx*sx + sy*sy > radius * radius) {
+        return false;
+    }
+
+    asteroid_to_shape_space(asteroid, x1, y1, &ax, &ay);
+    asteroid_to_shape_space(asteroid, x2, y2, &bx, &by);
+
+    if (asteroid_shape_contains(shape, ax, ay) || asteroid_shape_contains(shape, bx, by)) {
+        return true;
+    }
+
+    // Both ends outside, so it has to cross an edge
+    for (i = 0; i < NUM_VERTICES; ++i) {
+        int32 j = (i + 1) % NUM_VERTICES;
+        float cx = shape->vertices[2*i];
+        float cy = shape->vertices[2*i + 1];
+        float dx = shape->vertices[2*j];
+        float dy = shape->vertices[2*j + 1];
+        float d1 = (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+        float d2 = (bx - ax) * (dy - ay) - (by - ay) * (dx - ax);
+        float d3 = (dx - cx) * (ay - cy) - (dy - cy) * (ax - cx);
+        float d4 = (dx - cx) * (by - cy) - (dy - cy) * (bx - cx);
+
+        if (((d1 > 0.0f) != (d2 > 0.0f)) && ((d3 > 0.0f) != (d4 > 0.0f))) {
+            return true;
+        }
+    }
+
+    return false;
+}
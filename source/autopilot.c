@@ -0,0 +1,147 @@
+/*
+ *
+ * MIT License
+ * 
+ * Copyright (c) 2017 Wilk Maia
+ * wilkmaia [at] gmail [dot] com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ */
+
+
+/**
+ * Autopilot functions
+ *
+ * Flies the ship through the same inputs a player would use: it holds the
+ * arrow keys on pressed_keys and fires through the space bar path, aiming at
+ * the closest asteroid.
+ */
+
+#define WAS_USING_SHIP
+#define WAS_USING_BLAST
+#define WAS_USING_ASTEROID
+#define WAS_USING_AUTOPILOT
+#include "wasteroids.h"
+
+
+/*=========================================
+=            Local definitions            =
+=========================================*/
+
+/**
+ * Max angle between ship and target, in radians, to open fire
+ */
+static const float AIM_TOLERANCE = 0.15f;
+
+/**
+ * Targets farther than this are approached with thrust
+ */
+static const float CHASE_DISTANCE = 250.0f;
+
+/**
+ * Seconds between two shots
+ */
+static const float FIRE_COOLDOWN = 8.0f / SIM_DEFAULT_TICK_RATE;
+
+bool autopilot_enabled = false;
+static int32 fire_cooldown = 0;  // In ticks
+
+/*=====  End of Local definitions  ======*/
+
+
+
+/**
+ * @brief      Finds the closest asteroid to the ship
+ *
+ * @param[out] distance  Distance to the asteroid found
+ *
+ * @return     Pointer to asteroid, or NULL if there are none
+ */
+static Asteroid * autopilot_find_target(float *distance) {
+    Asteroid *target = NULL;
+    float best = 0.0f;
+    int32 i;
+
+    for (i = 0; i < num_asteroids; ++i) {
+        float dx = asteroids[i]->x - ship->x;
+        float dy = asteroids[i]->y - ship->y;
+        float d = dx * dx + dy * dy;
+
+        if (!target || d < best) {
+            target = asteroids[i];
+            best = d;
+        }
+    }
+
+    *distance = sqrtf(best);
+    return target;
+}
+
+/**
+ * @brief      Sets the ship's inputs for the next tick
+ */
+void autopilot_update() {
+    Asteroid *target;
+    float distance;
+    float angle;
+    float diff;
+
+    pressed_keys[ALLEGRO_KEY_LEFT] = false;
+    pressed_keys[ALLEGRO_KEY_RIGHT] = false;
+    pressed_keys[ALLEGRO_KEY_UP] = false;
+
+    if (fire_cooldown > 0) {
+        --fire_cooldown;
+    }
+
+    target = autopilot_find_target(&distance);
+    if (!target) {
+        return;
+    }
+
+    // Screen y grows downwards, while ship direction grows counterclockwise
+    angle = atan2f(ship->y - target->y, target->x - ship->x);
+    diff = angle - ship->direction;
+    while (diff > (float)ALLEGRO_PI) {
+        diff -= MAX_ANGLE;
+    }
+    while (diff < -(float)ALLEGRO_PI) {
+        diff += MAX_ANGLE;
+    }
+
+    // Turn towards target
+    if (diff > SHIP_TURN_RATE * sim_dt) {
+        pressed_keys[ALLEGRO_KEY_LEFT] = true;
+    }
+    else if (diff < -SHIP_TURN_RATE * sim_dt) {
+        pressed_keys[ALLEGRO_KEY_RIGHT] = true;
+    }
+
+    // Chase targets that are far away
+    if (distance > CHASE_DISTANCE && fabsf(diff) < AIM_TOLERANCE) {
+        pressed_keys[ALLEGRO_KEY_UP] = true;
+    }
+
+    // Shoot once aimed
+    if (fabsf(diff) < AIM_TOLERANCE && fire_cooldown == 0) {
+        fire_blast(ship);
+        fire_cooldown = (int32)(FIRE_COOLDOWN / sim_dt + 0.5f);
+    }
+}
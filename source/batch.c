@@ -0,0 +1,524 @@
+/*
+ *
+ * MIT License
+ * 
+ * Copyright (c) 2017 Wilk Maia
+ * wilkmaia [at] gmail [dot] com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ */
+
+
+/**
+ * Batch environment functions
+ *
+ * Steps many headless games in lockstep for bot training and balance testing.
+ * Games are split into slices, one per worker thread. A worker swaps each game
+ * of its slice into its own thread local simulation state and runs the regular
+ * game code on it, so no display is needed (Allegro must be initialised, though).
+ */
+
+#define WAS_USING_SHIP
+#define WAS_USING_BLAST
+#define WAS_USING_ASTEROID
+#define WAS_USING_BATCH
+#define WAS_USING_COLLIDE
+#include "wasteroids.h"
+
+
+/*=========================================
+=            Local definitions            =
+=========================================*/
+
+/**
+ * Simulation state of a single game while it is not being stepped
+ */
+typedef struct {
+    Ship *ship;
+    uint32 sim_rng_seed;
+    uint32 sim_tick;
+    Blast *blasts[BLAST_MAX];
+    int32 num_blasts;
+    Asteroid *asteroids[ASTEROID_MAX];
+    int32 num_asteroids;
+    uint32 score_count;
+    bool is_game_over;
+} BatchGame;
+
+typedef enum {
+    BATCH_OP_RESET,
+    BATCH_OP_STEP,
+    BATCH_OP_FREE
+} BatchOp;
+
+typedef struct {
+    BatchEnv *env;
+    ALLEGRO_THREAD *thread;
+    int32 first;
+    int32 last;
+} BatchWorker;
+
+struct BatchEnv {
+    BatchGame *games;
+    int32 num_games;
+    int32 width;
+    int32 height;
+    BatchObsMode mode;
+
+    BatchWorker *workers;
+    int32 num_workers;
+    ALLEGRO_MUTEX *mutex;
+    ALLEGRO_COND *work_cond;
+    ALLEGRO_COND *done_cond;
+    uint32 generation;
+    int32 pending;
+    bool quit;
+
+    // Arguments of the operation being run
+    BatchOp op;
+    const uint8 *actions;
+    void *observations;
+    float *rewards;
+    uint8 *done;
+};
+
+/**
+ * Seed of the benchmark's games, the same on every run
+ */
+#define BATCH_BENCHMARK_SEED 1
+
+/*=====  End of Local definitions  ======*/
+
+
+
+/**
+ * @brief      Loads a game into this thread's simulation state
+ *
+ * @param      game  The game
+ */
+static void batch_bind(BatchGame *game) {
+    ship = game->ship;
+    sim_rng_seed = game->sim_rng_seed;
+    sim_tick = game->sim_tick;
+    num_blasts = game->num_blasts;
+    memcpy(blasts, game->blasts, sizeof(Blast *) * num_blasts);
+    num_asteroids = game->num_asteroids;
+    memcpy(asteroids, game->asteroids, sizeof(Asteroid *) * num_asteroids);
+    score_count = game->score_count;
+    is_game_over = game->is_game_over;
+}
+
+/**
+ * @brief      Stores this thread's simulation state back into a game
+ *
+ * @param      game  The game
+ */
+static void batch_unbind(BatchGame *game) {
+    game->ship = ship;
+    game->sim_rng_seed = sim_rng_seed;
+    game->sim_tick = sim_tick;
+    game->num_blasts = num_blasts;
+    memcpy(game->blasts, blasts, sizeof(Blast *) * num_blasts);
+    game->num_asteroids = num_asteroids;
+    memcpy(game->asteroids, asteroids, sizeof(Asteroid *) * num_asteroids);
+    game->score_count = score_count;
+    game->is_game_over = is_game_over;
+}
+
+/**
+ * @brief      Marks the grid cell holding point (x, y)
+ *
+ * @param      grid  The occupancy grid
+ * @param[in]  x     x-coord
+ * @param[in]  y     y-coord
+ * @param[in]  bit   Cell bit to set
+ */
+static void batch_mark_cell(uint8 *grid, float x, float y, uint8 bit) {
+    int32 cx = (int32)(x * world_bounds.inv_width * BATCH_GRID_WIDTH);
+    int32 cy = (int32)(y * world_bounds.inv_height * BATCH_GRID_HEIGHT);
+
+    if (cx < 0 || cx >= BATCH_GRID_WIDTH || cy < 0 || cy >= BATCH_GRID_HEIGHT) {
+        return;
+    }
+
+    grid[cy * BATCH_GRID_WIDTH + cx] |= bit;
+}
+
+/**
+ * @brief      Writes the observation of the bound game into the caller's buffer
+ *
+ * @param      env    The batch environment
+ * @param[in]  index  Index of the game
+ */
+static void batch_observe(BatchEnv *env, int32 index) {
+    int32 i;
+
+    if (env->mode == BATCH_OBS_ENTITIES) {
+        float *obs = (float *)env->observations + (size_t)index * BATCH_OBS_ENTITIES_LEN;
+
+        memset(obs, 0, sizeof(float) * BATCH_OBS_ENTITIES_LEN);
+        obs[0] = ship->x * world_bounds.inv_width;
+        obs[1] = ship->y * world_bounds.inv_height;
+        obs[2] = ship->direction / MAX_ANGLE;
+        obs[3] = ship->lives;
+
+        for (i = 0; i < num_asteroids; ++i) {
+            obs[4 + 3*i] = asteroids[i]->x * world_bounds.inv_width;
+            obs[4 + 3*i + 1] = asteroids[i]->y * world_bounds.inv_height;
+            obs[4 + 3*i + 2] = asteroids[i]->scale;
+        }
+    }
+    else {
+        uint8 *grid = (uint8 *)env->observations
+                      + (size_t)index * BATCH_GRID_WIDTH * BATCH_GRID_HEIGHT;
+
+        memset(grid, 0, BATCH_GRID_WIDTH * BATCH_GRID_HEIGHT);
+        batch_mark_cell(grid, ship->x, ship->y, BATCH_CELL_SHIP);
+
+        for (i = 0; i < num_blasts; ++i) {
+            batch_mark_cell(grid, blasts[i]->x, blasts[i]->y, BATCH_CELL_BLAST);
+        }
+
+        for (i = 0; i < num_asteroids; ++i) {
+            batch_mark_cell(grid, asteroids[i]->x, asteroids[i]->y, BATCH_CELL_ASTEROID);
+        }
+    }
+}
+
+/**
+ * @brief      Gives every game its own random stream, derived from one seed
+ *
+ * @param      env   The batch environment
+ * @param[in]  seed  The seed
+ */
+static void batch_seed_games(BatchEnv *env, uint32 seed) {
+    int32 i;
+
+    for (i = 0; i < env->num_games; ++i) {
+        env->games[i].sim_rng_seed = sim_child_id(seed, (uint32)i);
+        env->games[i].sim_tick = 0;
+    }
+}
+
+/**
+ * @brief      Runs the current operation on games [first, last)
+ *
+ * @param      env    The batch environment
+ * @param[in]  first  First game
+ * @param[in]  last   One past the last game
+ */
+static void batch_run_slice(BatchEnv *env, int32 first, int32 last) {
+    int32 i;
+
+    world_set_bounds(env->width, env->height);
+
+    for (i = first; i < last; ++i) {
+        BatchGame *game = &(env->games[i]);
+
+        batch_bind(game);
+
+        if (env->op == BATCH_OP_RESET) {
+            if (ship) {
+                game_end();
+            }
+            game_start();
+        }
+        else if (env->op == BATCH_OP_STEP) {
+            uint8 action = env->actions[i];
+            uint32 prev_score = score_count;
+
+            ship->input = action & ~BATCH_ACTION_FIRE;
+            if (action & BATCH_ACTION_FIRE) {
+                fire_blast(ship);
+            }
+
+            game_tick();
+
+            // An episode ends on game over or once every asteroid is gone.
+            // Finished games start over right away, so the observation
+            // written below is the first one of the next episode.
+            env->rewards[i] = (float)(score_count - prev_score);
+            env->done[i] = is_game_over || num_asteroids == 0;
+            if (env->done[i]) {
+                game_end();
+                game_start();
+            }
+        }
+        else {
+            game_end();
+        }
+
+        if (env->op != BATCH_OP_FREE && env->observations) {
+            batch_observe(env, i);
+        }
+
+        batch_unbind(game);
+    }
+}
+
+/**
+ * @brief      Worker thread loop: runs its slice every time an operation is dispatched
+ *
+ * @param      thread  The thread
+ * @param      arg     The worker
+ *
+ * @return     NULL
+ */
+static void * batch_worker_run(ALLEGRO_THREAD *thread, void *arg) {
+    BatchWorker *worker = (BatchWorker *)arg;
+    BatchEnv *env = worker->env;
+    uint32 generation = 0;
+
+    while (true) {
+        al_lock_mutex(env->mutex);
+        while (env->generation == generation && !env->quit) {
+            al_wait_cond(env->work_cond, env->mutex);
+        }
+        if (env->quit) {
+            al_unlock_mutex(env->mutex);
+            break;
+        }
+        generation = env->generation;
+        al_unlock_mutex(env->mutex);
+
+        batch_run_slice(env, worker->first, worker->last);
+
+        al_lock_mutex(env->mutex);
+        --(env->pending);
+        if (env->pending == 0) {
+            al_broadcast_cond(env->done_cond);
+        }
+        al_unlock_mutex(env->mutex);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief      Runs an operation on every game and waits for all workers to finish it
+ *
+ * @param      env   The batch environment
+ * @param[in]  op    The operation
+ */
+static void batch_dispatch(BatchEnv *env, BatchOp op) {
+    al_lock_mutex(env->mutex);
+    env->op = op;
+    env->pending = env->num_workers;
+    ++(env->generation);
+    al_broadcast_cond(env->work_cond);
+
+    while (env->pending > 0) {
+        al_wait_cond(env->done_cond, env->mutex);
+    }
+    al_unlock_mutex(env->mutex);
+}
+
+
+/**
+ * @brief      Creates a new batch environment with all games started
+ *
+ * @param[in]  num_games    Number of games stepped together
+ * @param[in]  num_threads  Number of worker threads (0 for one per CPU)
+ * @param[in]  width        World width
+ * @param[in]  height       World height
+ * @param[in]  mode         Kind of observation written by reset and step
+ * @param[in]  seed         Seed every game's random stream is derived from
+ *
+ * @return     Pointer to new batch environment
+ */
+BatchEnv * batch_make_new(int32 num_games, int32 num_threads, int32 width, int32 height,
+                          BatchObsMode mode, uint32 seed) {
+    BatchEnv *env;
+    int32 i;
+
+    if (num_threads <= 0) {
+        num_threads = al_get_cpu_count();
+    }
+    if (num_threads <= 0) {
+        num_threads = 1;
+    }
+    if (num_threads > num_games) {
+        num_threads = num_games;
+    }
+
+    env = (BatchEnv *) calloc(1, sizeof(BatchEnv));
+    env->games = (BatchGame *) calloc(num_games, sizeof(BatchGame));
+    env->num_games = num_games;
+    env->width = width;
+    env->height = height;
+    env->mode = mode;
+
+    env->mutex = al_create_mutex();
+    env->work_cond = al_create_cond();
+    env->done_cond = al_create_cond();
+
+    env->num_workers = num_threads;
+    env->workers = (BatchWorker *) calloc(num_threads, sizeof(BatchWorker));
+    for (i = 0; i < num_threads; ++i) {
+        BatchWorker *worker = &(env->workers[i]);
+
+        worker->env = env;
+        worker->first = (int32)((int64)num_games * i / num_threads);
+        worker->last = (int32)((int64)num_games * (i + 1) / num_threads);
+        worker->thread = al_create_thread(batch_worker_run, worker);
+        if (!worker->thread) {
+            error("Failed to create batch worker thread");
+        }
+        al_start_thread(worker->thread);
+    }
+
+    batch_seed_games(env, seed);
+    env->observations = NULL;
+    batch_dispatch(env, BATCH_OP_RESET);
+
+    return env;
+}
+
+/**
+ * @brief      Stops the workers and frees every game and the environment itself
+ *
+ * @param      env   The batch environment
+ *
+ * @return     Pointer to object. Should point to NULL if everything went ok.
+ */
+BatchEnv * batch_delete(BatchEnv *env) {
+    int32 i;
+
+    batch_dispatch(env, BATCH_OP_FREE);
+
+    al_lock_mutex(env->mutex);
+    env->quit = true;
+    al_broadcast_cond(env->work_cond);
+    al_unlock_mutex(env->mutex);
+
+    for (i = 0; i < env->num_workers; ++i) {
+        al_join_thread(env->workers[i].thread, NULL);
+        al_destroy_thread(env->workers[i].thread);
+    }
+
+    al_destroy_cond(env->done_cond);
+    al_destroy_cond(env->work_cond);
+    al_destroy_mutex(env->mutex);
+    free(env->workers);
+    free(env->games);
+    free(env);
+    env = NULL;
+
+    return env;
+}
+
+/**
+ * @brief      Gets the size of a single game's observation
+ *
+ * @param      env   The batch environment
+ *
+ * @return     Size in bytes
+ */
+int32 batch_get_observation_size(BatchEnv *env) {
+    if (env->mode == BATCH_OBS_ENTITIES) {
+        return sizeof(float) * BATCH_OBS_ENTITIES_LEN;
+    }
+
+    return BATCH_GRID_WIDTH * BATCH_GRID_HEIGHT;
+}
+
+/**
+ * @brief      Starts every game over. The same seed replays the same games.
+ *
+ * @param      env           The batch environment
+ * @param[in]  seed          Seed every game's random stream is derived from
+ * @param[out] observations  num_games observations, or NULL
+ */
+void batch_reset(BatchEnv *env, uint32 seed, void *observations) {
+    batch_seed_games(env, seed);
+    env->observations = observations;
+    batch_dispatch(env, BATCH_OP_RESET);
+}
+
+/**
+ * @brief      Steps every game by one tick. Output is written straight into the caller's buffers.
+ *
+ * @param      env           The batch environment
+ * @param[in]  actions       num_games BATCH_ACTION_* masks
+ * @param[out] observations  num_games observations, or NULL
+ * @param[out] rewards       num_games score deltas
+ * @param[out] done          num_games flags, set when the game finished and was restarted
+ */
+void batch_step(BatchEnv *env, const uint8 *actions, void *observations,
+                float *rewards, uint8 *done) {
+    env->actions = actions;
+    env->observations = observations;
+    env->rewards = rewards;
+    env->done = done;
+    batch_dispatch(env, BATCH_OP_STEP);
+}
+
+/**
+ * @brief      Steps num_games games num_steps times and prints the aggregate tick rate
+ *
+ * @param[in]  num_games  Number of games
+ * @param[in]  num_steps  Number of steps
+ */
+void batch_benchmark(int32 num_games, int32 num_steps) {
+    BatchEnv *env;
+    uint8 *actions;
+    void *observations;
+    float *rewards;
+    uint8 *done;
+    uint32 episodes;
+    double start;
+    double elapsed;
+    int32 i;
+    int32 j;
+
+    env = batch_make_new(num_games, 0, 800, 600, BATCH_OBS_ENTITIES, BATCH_BENCHMARK_SEED);
+    actions = (uint8 *) malloc(num_games);
+    observations = malloc((size_t)num_games * batch_get_observation_size(env));
+    rewards = (float *) malloc(sizeof(float) * num_games);
+    done = (uint8 *) malloc(num_games);
+    episodes = 0;
+
+    batch_reset(env, BATCH_BENCHMARK_SEED, observations);
+
+    start = al_get_time();
+    for (i = 0; i < num_steps; ++i) {
+        // Cheap varied input: every game cycles through all actions at its own phase
+        for (j = 0; j < num_games; ++j) {
+            actions[j] = (uint8)(((j * 7) + (i / 16)) & 0x0f);
+        }
+
+        batch_step(env, actions, observations, rewards, done);
+
+        for (j = 0; j < num_games; ++j) {
+            episodes += done[j];
+        }
+    }
+    elapsed = al_get_time() - start;
+
+    printf("%d games x %d steps on %d threads: %.3f s, %.0f ticks/s, %u episodes (%s collision kernel)\n",
+           num_games, num_steps, env->num_workers, elapsed,
+           (double)num_games * num_steps / elapsed, episodes, collide_get_kernel_name());
+
+    free(done);
+    free(rewards);
+    free(observations);
+    free(actions);
+    batch_delete(env);
+}
@@ -59,6 +59,7 @@ Blast * blast_make_new(float x, float y, float direction, float size, float spee
     newBlast->direction = direction;
     newBlast->size = size;
     newBlast->speed = speed;
+    sim_place(&newBlast->motion, x, y);
     newBlast->alive = alive;
     newBlast->color = color;
     newBlast->thickness = thickness;
@@ -82,7 +83,7 @@ Blast * blast_make_new(float x, float y, float direction, float size, float spee
 Blast * blast_make_new_default(float x, float y, float direction) {
     Blast * newBlast;
     float size = 20.0f;
-    float speed = 10.0f;
+    float speed = 600.0f;
     bool alive = true;
     ALLEGRO_COLOR color = BLAST_COLOR;
     float thickness = 3.0f;
@@ -115,10 +116,13 @@ int8 blast_draw(Blast *blast) {
     al_identity_transform(&transform);
     al_rotate_transform(&transform, -blast->direction + ALLEGRO_PI / 2.0f);
     al_translate_transform(&transform, blast->x, blast->y);
+    if (prevTransform != NULL) {
+        al_compose_transform(&transform, prevTransform);
+    }
     al_use_transform(&transform);
 
     // Draws blast
-    al_draw_line(0, -11, 0, -11 - blast->size, blast->color, blast->thickness);
+    al_draw_line(0, -11, 0, -11 - blast->size, blast->color, RENDER_THICKNESS(blast->thickness));
 
     // Reloads previous transform state
     if (prevTransform != NULL) {
@@ -147,8 +151,25 @@ void blast_draw_all() {
  * @param[out] y      Address to end-point y-coordinate
  */
 void blast_get_end_point(Blast *blast, float *x, float *y) {
-    *x = blast->x + blast->size * cos(blast->direction);
-    *y = blast->y - blast->size * sin(blast->direction);
+    *x = blast->x + blast->size * sim_cos(blast->direction);
+    *y = blast->y - blast->size * sim_sin(blast->direction);
+}
+
+/**
+ * @brief      Gets the segment covered by the blast over the last tick, from
+ *             where its tail was before moving to where its tip is now.
+ *             Blasts fly straight and die at the border, so this is exact.
+ *
+ * @param      blast  The blast
+ * @param[out] x1     Address to the old tail's x-coordinate
+ * @param[out] y1     Address to the old tail's y-coordinate
+ * @param[out] x2     Address to the tip's x-coordinate
+ * @param[out] y2     Address to the tip's y-coordinate
+ */
+void blast_get_swept_segment(Blast *blast, float *x1, float *y1, float *x2, float *y2) {
+    *x1 = blast->x - blast->speed * sim_dt * sim_cos(blast->direction);
+    *y1 = blast->y + blast->speed * sim_dt * sim_sin(blast->direction);
+    blast_get_end_point(blast, x2, y2);
 }
 
 /**
@@ -202,9 +223,6 @@ void blast_delete_all() {
  * @param      blast  The blast
  */
 void blast_move(Blast *blast) {
-    float dx;
-    float dy;
-
     int32 width;
     int32 height;
 
@@ -214,8 +232,8 @@ void blast_move(Blast *blast) {
         return;
     }
 
-    width = al_get_display_width(screen);
-    height = al_get_display_height(screen);
+    width = world_bounds.width;
+    height = world_bounds.height;
 
     // Check if out of bounds
     if (blast->x < 0 || blast->x > width 
@@ -225,11 +243,7 @@ void blast_move(Blast *blast) {
         return;
     }
 
-    dx = blast->speed * cos(blast->direction);
-    dy = - blast->speed * sin(blast->direction);
-
-    blast->x += dx;
-    blast->y += dy;
+    sim_advance(&blast->motion, &blast->x, &blast->y, blast->speed * sim_dt, blast->direction);
 }
 
 /**
@@ -0,0 +1,261 @@
+/*
+ *
+ * MIT License
+ * 
+ * Copyright (c) 2017 Wilk Maia
+ * wilkmaia [at] gmail [dot] com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ */
+
+
+/**
+ * Collision candidate functions
+ *
+ * Broadphase for the collision checks: tests one query box against the
+ * bounding boxes of every asteroid, several at a time, and returns a bit
+ * mask of the asteroids worth an exact test. Asteroid boxes are gathered
+ * into aligned arrays, padded with empty boxes up to a multiple of the
+ * widest kernel. The kernel (AVX2, SSE2 or plain C) is picked once at
+ * startup from what the CPU supports.
+ */
+
+#define WAS_USING_SHIP
+#define WAS_USING_BLAST
+#define WAS_USING_ASTEROID
+#define WAS_USING_COLLIDE
+#include "wasteroids.h"
+
+#include <float.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define COLLIDE_X86_GNU
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_AMD64))
+#define COLLIDE_X86_MSVC
+#include <emmintrin.h>
+#endif
+
+
+/*=========================================
+=            Local definitions            =
+=========================================*/
+
+typedef void (*CollideKernel)(const CollideBounds *bounds, float x1, float y1,
+                              float x2, float y2, uint32 *mask);
+
+static void collide_kernel_scalar(const CollideBounds *bounds, float x1, float y1,
+                                  float x2, float y2, uint32 *mask);
+
+static CollideKernel kernel = collide_kernel_scalar;
+static const char *kernel_name = "scalar";
+
+/*=====  End of Local definitions  ======*/
+
+
+
+/**
+ * @brief      Plain C kernel
+ *
+ * @param      bounds  Asteroid boxes
+ * @param[in]  x1      Query box's top left corner's x-coordinate
+ * @param[in]  y1      Query box's top left corner's y-coordinate
+ * @param[in]  x2      Query box's bottom right corner's x-coordinate
+ * @param[in]  y2      Query box's bottom right corner's y-coordinate
+ * @param[out] mask    One bit per asteroid, set when the boxes overlap
+ */
+static void collide_kernel_scalar(const CollideBounds *bounds, float x1, float y1,
+                                  float x2, float y2, uint32 *mask) {
+    int32 i;
+
+    for (i = 0; i < bounds->padded; ++i) {
+        if (bounds->x1[i] <= x2 && bounds->x2[i] >= x1
+                && bounds->y1[i] <= y2 && bounds->y2[i] >= y1) {
+            mask[i / 32] |= 1u << (i % 32);
+        }
+    }
+}
+
+#if defined(COLLIDE_X86_GNU) || defined(COLLIDE_X86_MSVC)
+/**
+ * @brief      SSE2 kernel, 4 boxes per step. Same arguments as the plain C one.
+ */
+#ifdef COLLIDE_X86_GNU
+__attribute__((target("sse2")))
+#endif
+static void collide_kernel_sse2(const CollideBounds *bounds, float x1, float y1,
+                                float x2, float y2, uint32 *mask) {
+    __m128 qx1 = _mm_set1_ps(x1);
+    __m128 qy1 = _mm_set1_ps(y1);
+    __m128 qx2 = _mm_set1_ps(x2);
+    __m128 qy2 = _mm_set1_ps(y2);
+    int32 i;
+
+    for (i = 0; i < bounds->padded; i += 4) {
+        __m128 hit = _mm_and_ps(
+            _mm_and_ps(_mm_cmple_ps(_mm_load_ps(&bounds->x1[i]), qx2),
+                       _mm_cmpge_ps(_mm_load_ps(&bounds->x2[i]), qx1)),
+            _mm_and_ps(_mm_cmple_ps(_mm_load_ps(&bounds->y1[i]), qy2),
+                       _mm_cmpge_ps(_mm_load_ps(&bounds->y2[i]), qy1)));
+
+        mask[i / 32] |= (uint32)_mm_movemask_ps(hit) << (i % 32);
+    }
+}
+#endif
+
+#ifdef COLLIDE_X86_GNU
+/**
+ * @brief      AVX2 kernel, 8 boxes per step. Same arguments as the plain C one.
+ */
+__attribute__((target("avx2")))
+static void collide_kernel_avx2(const CollideBounds *bounds, float x1, float y1,
+                                float x2, float y2, uint32 *mask) {
+    __m256 qx1 = _mm256_set1_ps(x1);
+    __m256 qy1 = _mm256_set1_ps(y1);
+    __m256 qx2 = _mm256_set1_ps(x2);
+    __m256 qy2 = _mm256_set1_ps(y2);
+    int32 i;
+
+    for (i = 0; i < bounds->padded; i += 8) {
+        __m256 hit = _mm256_and_ps(
+            _mm256_and_ps(_mm256_cmp_ps(_mm256_load_ps(&bounds->x1[i]), qx2, _CMP_LE_OQ),
+                          _mm256_cmp_ps(_mm256_load_ps(&bounds->x2[i]), qx1, _CMP_GE_OQ)),
+            _mm256_and_ps(_mm256_cmp_ps(_mm256_load_ps(&bounds->y1[i]), qy2, _CMP_LE_OQ),
+                          _mm256_cmp_ps(_mm256_load_ps(&bounds->y2[i]), qy1, _CMP_GE_OQ)));
+
+        mask[i / 32] |= (uint32)_mm256_movemask_ps(hit) << (i % 32);
+    }
+}
+#endif
+
+/**
+ * @brief      Picks the widest kernel the CPU supports. Must run before any
+ *             simulation thread starts; until then the plain C kernel is used.
+ */
+void collide_init() {
+#if defined(COLLIDE_X86_GNU)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernel = collide_kernel_avx2;
+        kernel_name = "avx2";
+    }
+    else if (__builtin_cpu_supports("sse2")) {
+        kernel = collide_kernel_sse2;
+        kernel_name = "sse2";
+    }
+#elif defined(COLLIDE_X86_MSVC)
+    // Every x86-64 CPU has SSE2
+    kernel = collide_kernel_sse2;
+    kernel_name = "sse2";
+#endif
+}
+
+/**
+ * @brief      Gets the name of the kernel in use
+ *
+ * @return     "avx2", "sse2" or "scalar"
+ */
+const char * collide_get_kernel_name() {
+    return kernel_name;
+}
+
+/**
+ * @brief      Copies the bounding box of every asteroid into bounds
+ *
+ * @param[out] bounds  Asteroid boxes
+ */
+void collide_gather_asteroids(CollideBounds *bounds) {
+    int32 i;
+
+    bounds->n = num_asteroids;
+    bounds->padded = (num_asteroids + COLLIDE_LANES - 1) / COLLIDE_LANES * COLLIDE_LANES;
+
+    for (i = 0; i < num_asteroids; ++i) {
+        asteroid_get_corners(asteroids[i], &bounds->x1[i], &bounds->y1[i],
+                             &bounds->x2[i], &bounds->y2[i]);
+    }
+
+    // Inside-out boxes never overlap anything
+    for (; i < bounds->padded; ++i) {
+        bounds->x1[i] = FLT_MAX;
+        bounds->y1[i] = FLT_MAX;
+        bounds->x2[i] = -FLT_MAX;
+        bounds->y2[i] = -FLT_MAX;
+    }
+}
+
+/**
+ * @brief      Finds the asteroids whose boxes overlap the query box
+ *
+ * @param      bounds  Asteroid boxes, from collide_gather_asteroids
+ * @param[in]  x1      Query box's top left corner's x-coordinate
+ * @param[in]  y1      Query box's top left corner's y-coordinate
+ * @param[in]  x2      Query box's bottom right corner's x-coordinate
+ * @param[in]  y2      Query box's bottom right corner's y-coordinate
+ * @param[out] mask    One bit per asteroid, COLLIDE_MASK_WORDS words
+ *
+ * @return     true if any asteroid is a candidate; false otherwise
+ */
+bool collide_query(const CollideBounds *bounds, float x1, float y1, float x2, float y2,
+                   uint32 *mask) {
+    uint32 any = 0;
+    int32 i;
+
+    memset(mask, 0, sizeof(uint32) * COLLIDE_MASK_WORDS);
+    kernel(bounds, x1, y1, x2, y2, mask);
+
+    for (i = 0; i < COLLIDE_MASK_WORDS; ++i) {
+        any |= mask[i];
+    }
+
+    return any != 0;
+}
+
+/**
+ * @brief      Finds the first candidate at or after an index
+ *
+ * @param      mask   Candidate mask
+ * @param[in]  n      Number of asteroids
+ * @param[in]  start  First index to look at
+ *
+ * @return     Index of the candidate, or n if there's none left
+ */
+int32 collide_next(const uint32 *mask, int32 n, int32 start) {
+    int32 i;
+
+    for (i = start; i < n; ++i) {
+        uint32 word = mask[i / 32] >> (i % 32);
+
+        if (word == 0) {
+            // Skips the rest of the word
+            i = (i / 32) * 32 + 31;
+            continue;
+        }
+
+        while (!(word & 1u)) {
+            word >>= 1;
+            ++i;
+        }
+
+        return i < n ? i : n;
+    }
+
+    return n;
+}
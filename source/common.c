@@ -34,6 +34,19 @@
 #define WAS_USING_BLAST
 #define WAS_USING_ASTEROID
 #define WAS_USING_TEXT
+#define WAS_USING_AUTOPILOT
+#define WAS_USING_SOAK
+#define WAS_USING_SNAPSHOT
+#define WAS_USING_NETPLAY
+#define WAS_USING_SPECTATE
+#define WAS_USING_PARTICLE
+#define WAS_USING_GOVERNOR
+#define WAS_USING_COLLIDE
+#define WAS_USING_FIXED
+#define WAS_USING_PACER
+#define WAS_USING_RENDER
+#define WAS_USING_STARTUP
+#define WAS_USING_IO
 #include "wasteroids.h"
 
 
@@ -43,46 +56,89 @@
 
 struct ALLEGRO_DISPLAY *screen;
 struct ALLEGRO_FONT *font;
-bool pressed_keys[ALLEGRO_KEY_MAX];
+bool render_hairlines = false;
+WAS_THREAD_LOCAL bool pressed_keys[ALLEGRO_KEY_MAX];
 
-Ship *ship;
+WAS_THREAD_LOCAL WorldBounds world_bounds = { 0, 0, 0.0f, 0.0f };
 
-Blast *(blasts[BLAST_MAX]);
-int32 num_blasts = 0;
+WAS_THREAD_LOCAL Ship *ship;
+WAS_THREAD_LOCAL Ship *ship2 = NULL;
 
-Asteroid *(asteroids[ASTEROID_MAX]);
-int32 num_asteroids = 0;
+WAS_THREAD_LOCAL uint32 sim_rng_seed = 0;
+WAS_THREAD_LOCAL uint32 sim_tick = 0;
+WAS_THREAD_LOCAL float sim_dt = 1.0f / SIM_DEFAULT_TICK_RATE;
+
+WAS_THREAD_LOCAL Blast *(blasts[BLAST_MAX]);
+WAS_THREAD_LOCAL int32 num_blasts = 0;
+
+WAS_THREAD_LOCAL Asteroid *(asteroids[ASTEROID_MAX]);
+WAS_THREAD_LOCAL int32 num_asteroids = 0;
 
 const float SHIP_DIMENSION = 20.0f;
 const float ASTEROID_DIMENSION = 20.0f;
 
 const float MAX_ANGLE = 2.0f * (float) ALLEGRO_PI;
 
-const float VERTICES[] = {
-    -20, 20,
-    -25, 5,
-    -25, -10,
-    -5, -10,
-    -10, -20,
-    5, -20,
-    20, -10,
-    20, -5,
-    0, 0,
-    20, 10,
-    10, 20,
-    0, 15
-};
-
-bool is_game_over = false;
+AsteroidShape asteroid_shapes[ASTEROID_SHAPES];
+
+WAS_THREAD_LOCAL bool is_game_over = false;
 
 text *score = NULL;
 
-uint32 score_count = 0;
+WAS_THREAD_LOCAL uint32 score_count = 0;
 
 /*=====  End of Project global variables and constants  ======*/
 
 
 
+/*=========================================
+=            Local definitions            =
+=========================================*/
+
+typedef enum {
+    COLLISION_BLAST_ASTEROID,
+    COLLISION_SHIP_ASTEROID
+} CollisionType;
+
+/**
+ * A hit found during the collision phase, applied by resolve_collisions
+ */
+typedef struct {
+    CollisionType type;
+    Blast *blast;
+    Ship *ship;
+    Asteroid *asteroid;
+} CollisionEvent;
+
+/**
+ * Every blast hits at most one asteroid and every ship at most once a tick
+ */
+#define COLLISION_EVENTS_MAX (BLAST_MAX + 2)
+
+static WAS_THREAD_LOCAL CollisionEvent collision_events[COLLISION_EVENTS_MAX];
+static WAS_THREAD_LOCAL int32 num_collision_events = 0;
+
+/**
+ * When the last local tick ran, to tell how far into the next one a frame is
+ */
+static double last_tick_time = 0.0;
+
+/**
+ * Local games pause on P, and every game notes when its window loses focus
+ */
+static bool is_paused = false;
+static bool is_unfocused = false;
+
+/**
+ * Score the score text shows. The text belongs to the main thread, so
+ * ticks, which batch workers run too, leave it alone.
+ */
+static uint32 score_shown = 0;
+
+/*=====  End of Local definitions  ======*/
+
+
+
 void error(char *msg) {
     fprintf(stderr, "%s: %s", msg, strerror(errno));
     exit(1);
@@ -99,8 +155,29 @@ void print_usage_message() {
         "width and height set screen resolution\n"
         "Other options are:\n"
         "\t--fullscreen\tenables full screen mode (makes width and height optional)\n"
+        "\t--autopilot\tlets the computer fly the ship\n"
+        "\t--soak HOURS\truns the autopilot for HOURS, restarting finished games and logging stats\n"
+        "\t--host PORT\thosts a two-player game on UDP port PORT\n"
+        "\t--join HOST:PORT\tjoins a two-player game\n"
+        "\t--net-latency MS\tdelays every outgoing two-player packet by MS\n"
+        "\t--net-loss PERCENT\tdrops PERCENT of outgoing two-player packets\n"
+        "\t--broadcast PORT\tstreams the game to spectators on UDP port PORT\n"
+        "\t--spectate HOST:PORT\twatches a broadcast game\n"
+        "\t--no-governor\tkeeps full render quality even when frames run late\n"
+        "\t--tick-rate HZ\tsimulation ticks per second (default 60), gameplay speed stays the same\n"
+        "\t--fps-cap HZ\tdraws at most HZ frames per second, 0 for uncapped (default: one per tick)\n"
+        "\t--vsync MODE\ton or off, left to the driver by default\n"
+        "\t--render-scale S\tdraws at S (0.25 to 1) times the display resolution and upscales\n"
+        "\t--pacer\t\tpaces ticks by sleeping then spinning on the monotonic clock, one frame per tick\n"
+        "\t--pin-core N\tlike --pacer, and pins the main thread to core N\n"
+        "\t--latency-probe\tmeasures time from key press to screen and prints it on exit\n"
+        "\t--startup-report\tprints how long startup took to show the first frame\n"
+        "\t--asset-bench N\tloads the default font N times, embedded and off the disk, and reports the time\n"
+        "\t--batch-bench N\truns N headless games in lockstep and reports ticks per second\n"
         "\t--help [-h]\tdisplays this message\n"
         "\n"
+        "P pauses a local game. Paused, unfocused and finished games stop their timers and sleep.\n"
+        "\n"
         "Example:\n"
         "\twasteroids 1024 768\n"
         "\twasteroids --fullscreen\n"
@@ -135,14 +212,28 @@ void set_config_string(ALLEGRO_CONFIG *cfg, const char *section,
     al_set_config_value(cfg, section, name, val);
 }
 
-bool run_game() {
-    ALLEGRO_EVENT ev;
-    input_wait_for_event(&ev);
-    bool redraw = false;
+/**
+ * @brief      Checks if the local ship can be drawn with late-sampled input
+ *
+ * @return     true if so; false otherwise
+ */
+static bool can_sample_late() {
+    return ship && !is_game_over && !is_paused && !autopilot_enabled
+           && !netplay_is_running() && !spectate_is_viewing();
+}
 
+/**
+ * @brief      Handles one key press or release from the input thread
+ *
+ * @param      key     The key event
+ * @param[out] redraw  Set when the screen needs redrawing
+ *
+ * @return     false to finish the game; true otherwise
+ */
+static bool handle_key(const InputKey *key, bool *redraw) {
     // Checks for key pressed
-    if (ev.type == ALLEGRO_EVENT_KEY_DOWN) {
-        switch (ev.keyboard.keycode) {
+    if (key->down) {
+        switch (key->keycode) {
             // Finishes the game
             case ALLEGRO_KEY_ESCAPE:
                 return false;
@@ -152,14 +243,54 @@ bool run_game() {
             case ALLEGRO_KEY_DOWN:
             case ALLEGRO_KEY_LEFT:
             case ALLEGRO_KEY_RIGHT:
-                pressed_keys[ev.keyboard.keycode] = true;
+                pressed_keys[key->keycode] = true;
+
+                // Turning shows on the next frame, thrust only after a tick
+                if (key->keycode != ALLEGRO_KEY_DOWN) {
+                    input_probe_key(key->timestamp,
+                                    key->keycode == ALLEGRO_KEY_UP || !can_sample_late());
+                }
+                *redraw = true;
                 break;
 
             // Fires blast
+            // Two-player games fire on the next tick, so both peers see it
             case ALLEGRO_KEY_SPACE:
-                if (num_blasts >= BLAST_MAX)
+                if (spectate_is_viewing()) {
                     break;
-                blast_make_new_default(ship->x, ship->y, ship->direction);
+                }
+                else if (netplay_is_running()) {
+                    netplay_fire();
+                    input_probe_key(key->timestamp, true);
+                }
+                else {
+                    fire_blast(ship);
+                    input_probe_key(key->timestamp, false);
+                    *redraw = true;
+                }
+                break;
+
+            // Quick-save and quick-load
+            // Not in two-player games, where it would desync the peers
+            case ALLEGRO_KEY_F5:
+                if (!netplay_is_running() && !spectate_is_viewing()) {
+                    snapshot_quick_save();
+                }
+                break;
+
+            // Pause, only where nobody else depends on the game moving on
+            case ALLEGRO_KEY_P:
+                if (!netplay_is_running() && !spectate_is_viewing() && !soak_is_running()) {
+                    is_paused = !is_paused;
+                    *redraw = true;
+                }
+                break;
+
+            case ALLEGRO_KEY_F9:
+                if (!netplay_is_running() && !spectate_is_viewing()
+                        && snapshot_quick_load()) {
+                    update_score_text();
+                }
                 break;
 
             default:
@@ -167,55 +298,281 @@ bool run_game() {
         }
     }
     // Check for key released
-    else if (ev.type == ALLEGRO_EVENT_KEY_UP) {
+    else {
         // Stop moving ship
-        switch (ev.keyboard.keycode) {
+        switch (key->keycode) {
             case ALLEGRO_KEY_UP:
             case ALLEGRO_KEY_DOWN:
             case ALLEGRO_KEY_LEFT:
             case ALLEGRO_KEY_RIGHT:
-                pressed_keys[ev.keyboard.keycode] = false;
+                pressed_keys[key->keycode] = false;
                 break;
 
             default:
                 break;
         }
     }
-    // Checks for timer event
+
+    return true;
+}
+
+/**
+ * @brief      Handles every key the input thread queued up
+ *
+ * @param[out] redraw  Set when the screen needs redrawing
+ *
+ * @return     false to finish the game; true otherwise
+ */
+static bool handle_keys(bool *redraw) {
+    InputKey key;
+
+    while (input_next_key(&key)) {
+        if (!handle_key(&key, redraw)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief      Checks if nothing on screen can change until an event comes in
+ *
+ * @return     true if the loop can block; false otherwise
+ */
+static bool should_idle() {
+    // Network peers, viewers and soak tests need ticks whatever the screen shows
+    if (netplay_is_running() || spectate_is_viewing() || spectate_is_broadcasting()
+            || soak_is_running()) {
+        return false;
+    }
+
+    // Game over waits for the last debris to fade
+    return is_paused || is_unfocused || (is_game_over && !particle_any_alive());
+}
+
+/**
+ * @brief      Runs one simulation tick
+ *
+ * @param[out] redraw  Set when the screen needs redrawing
+ *
+ * @return     false to finish the game; true otherwise
+ */
+static bool handle_tick(bool *redraw) {
+    double timer_start = al_get_time();
+
+    // Keys pressed since the last tick
+    if (!handle_keys(redraw)) {
+        return false;
+    }
+
+    // Paused games keep reading keys, to unpause
+    if (is_paused) {
+        return true;
+    }
+
+    // Soak tests start finished games over and stop once their time is up
+    if (soak_is_running() && !soak_update()) {
+        return false;
+    }
+
+    // Spectators only show what the broadcaster sends
+    if (spectate_is_viewing()) {
+        spectate_update();
+    }
+    // Two-player games tick through the rollback layer
+    else if (netplay_is_running()) {
+        netplay_update();
+        input_probe_tick();
+    }
     // If game is over, there's no update on screen
-    else if (ev.type == ALLEGRO_EVENT_TIMER && !is_game_over) {
-        // TODO Run game logic
-        // Move objects around
-        ship_move(ship);
-        blast_move_all();
-        asteroid_move_all();
-
-        // Check for collision
-        check_blasts_on_asteroids();
-        check_ship_on_asteroids();
-
-        if (!ship->can_be_hit) {
-            ++(ship->can_be_hit_count);
-            if (ship->can_be_hit_count >= 60) {
-                ship->can_be_hit = true;
-                ship->can_be_hit_count = 0;
+    else if (!is_game_over) {
+        double tick_start;
+
+        if (autopilot_enabled) {
+            autopilot_update();
+        }
+        ship->input = input_get_controls();
+
+        tick_start = al_get_time();
+        game_tick();
+        last_tick_time = tick_start;
+        input_probe_tick();
+        if (soak_is_running()) {
+            soak_record_tick(al_get_time() - tick_start);
+        }
+    }
+
+    // Once per tick, however many hits there were
+    if (score_count != score_shown) {
+        update_score_text();
+    }
+
+    // Particles are cosmetic and keep moving on game over
+    particle_update(sim_dt);
+
+    // Viewers are sent a state every tick, even when nothing moves
+    if (spectate_is_broadcasting()) {
+        spectate_broadcast();
+    }
+
+    governor_record_tick(al_get_time() - timer_start);
+    io_check_stall();
+
+    return true;
+}
+
+/**
+ * @brief      Handles one event
+ *
+ * @param      ev      The event
+ * @param[out] redraw  Set when the screen needs redrawing
+ *
+ * @return     false to finish the game; true otherwise
+ */
+static bool handle_event(ALLEGRO_EVENT *ev, bool *redraw) {
+    switch (ev->type) {
+        case ALLEGRO_EVENT_DISPLAY_SWITCH_OUT:
+            is_unfocused = true;
+            break;
+
+        case ALLEGRO_EVENT_DISPLAY_SWITCH_IN:
+            is_unfocused = false;
+            *redraw = true;
+            break;
+
+        case ALLEGRO_EVENT_DISPLAY_EXPOSE:
+            *redraw = true;
+            break;
+
+        // The world follows the window, except where a peer or broadcaster
+        // owns its size
+        case ALLEGRO_EVENT_DISPLAY_RESIZE:
+            al_acknowledge_resize(ev->display.source);
+            render_resize(ev->display.width, ev->display.height);
+            if (!netplay_is_running() && !spectate_is_viewing()) {
+                world_set_bounds(ev->display.width, ev->display.height);
+            }
+            *redraw = true;
+            break;
+
+        default:
+            break;
+    }
+
+    if (input_is_tick(ev) && !handle_tick(redraw)) {
+        return false;
+    }
+
+    // Unless frames have a rate of their own, every tick gets one
+    if (input_is_frame(ev)) {
+        *redraw = true;
+    }
+
+    return true;
+}
+
+bool run_game() {
+    ALLEGRO_EVENT ev;
+    bool redraw = false;
+
+    // Nothing moves while idle: the timers stop and the loop blocks until a
+    // key or display event, so an idle game costs next to no CPU
+    if (should_idle()) {
+        input_set_idle(true);
+
+        // A key that beat the switch sent no wake: take it before blocking
+        if (!handle_keys(&redraw)) {
+            return false;
+        }
+        if (should_idle() && !redraw) {
+            input_wait_for_event(&ev);
+            do {
+                if (!handle_event(&ev, &redraw)) {
+                    return false;
+                }
+            } while (input_get_next_event(&ev));
+            if (!handle_keys(&redraw)) {
+                return false;
             }
         }
 
-        // Sets flag for screen redrawing
+        // Picks up right away, with the next tick a whole period from now
+        if (!should_idle()) {
+            input_set_idle(false);
+            if (pacer_is_enabled()) {
+                pacer_resync();
+            }
+            last_tick_time = al_get_time();
+            redraw = true;
+        }
+    }
+    // The pacer replaces the tick timer, and every tick gets a frame
+    else if (pacer_is_enabled()) {
+        pacer_wait();
+        while (input_get_next_event(&ev)) {
+            if (!handle_event(&ev, &redraw)) {
+                return false;
+            }
+        }
+        if (!handle_tick(&redraw)) {
+            return false;
+        }
+        redraw = true;
+    }
+    // Uncapped frame rate never waits, and draws on every pass
+    else if (input_is_uncapped()) {
+        while (input_get_next_event(&ev)) {
+            if (!handle_event(&ev, &redraw)) {
+                return false;
+            }
+        }
         redraw = true;
     }
+    // Otherwise waits for a tick, frame or display event, then drains
+    // everything that piled up so the frame drawn below reflects all of it
+    else {
+        input_wait_for_event(&ev);
+        do {
+            if (!handle_event(&ev, &redraw)) {
+                return false;
+            }
+        } while (input_get_next_event(&ev));
+    }
 
-    if (redraw && input_is_queue_empty()) {
-        // Redraws objects on screen
+    if (redraw) {
+        double draw_start = al_get_time();
+
+        // Redraws objects on screen, at the render scale
+        render_begin();
         al_clear_to_color(al_map_rgb(0, 0, 0));
         
-        ship_draw(ship);
+        // Spectators have no ship until the first state arrives
+        if (ship) {
+            float direction = ship->direction;
+
+            // Turning keys are read right before drawing, not a tick ago
+            if (can_sample_late()) {
+                ship->direction = ship_get_late_direction(ship, input_get_live_controls(),
+                    (float)((draw_start - last_tick_time) / input_get_tick_period()));
+            }
+            ship_draw(ship);
+            ship->direction = direction;
+        }
+        if (ship2) {
+            ship_draw(ship2);
+        }
         blast_draw_all();
         asteroid_draw_all();
+        particle_draw_all();
         text_draw(score);
+        render_end();
 
+        // Flipping may wait for vsync, which isn't drawing cost
+        governor_record_draw(al_get_time() - draw_start);
         al_flip_display();
+        input_probe_frame_shown();
+        startup_frame_shown();
     }
 
     return true;
@@ -232,49 +589,320 @@ bool common_check_collision(float x, float y, float corner_x1, float corner_y1,
 }
 
 void check_blasts_on_asteroids() {
+    CollideBounds bounds;
+    uint32 mask[COLLIDE_MASK_WORDS];
+    bool taken[ASTEROID_MAX] = { false };
     int32 i;
 
+    collide_gather_asteroids(&bounds);
+
     // For each blast
     for (i = 0; i < num_blasts; ++i) {
-        // Check collision on asteroids
+        float x1;
+        float y1;
+        float x2;
+        float y2;
         int32 j;
-        for (j = 0; j < num_asteroids; ++j) {
-            // If they collide
-            if (asteroid_check_collision_on_blast(asteroids[j], blasts[i])) {
-                char msg[TEXT_MESSAGE_LENGTH] = {};
 
-                // Handle the asteroid collision
-                asteroid_was_hit(asteroids[j]);
+        // Only asteroids whose box overlaps what the blast swept get an exact test
+        blast_get_swept_segment(blasts[i], &x1, &y1, &x2, &y2);
+        if (!collide_query(&bounds, fminf(x1, x2), fminf(y1, y2),
+                           fmaxf(x1, x2), fmaxf(y1, y2), mask)) {
+            continue;
+        }
 
-                // Deletes blast
-                blast_delete(blasts[i]);
+        // Check collision on asteroids nobody hit yet this tick
+        for (j = collide_next(mask, num_asteroids, 0); j < num_asteroids;
+                j = collide_next(mask, num_asteroids, j + 1)) {
+            // If they collide
+            if (!taken[j] && asteroid_check_collision_on_blast(asteroids[j], blasts[i])) {
+                CollisionEvent *event = &collision_events[num_collision_events++];
 
-                // Increases score
-                score_count += 100;
-                sprintf(msg, "Score: %d", score_count);
-                text_update_msg(score, msg);
+                event->type = COLLISION_BLAST_ASTEROID;
+                event->blast = blasts[i];
+                event->ship = NULL;
+                event->asteroid = asteroids[j];
+                taken[j] = true;
+
+                // Blast is spent, move on to the next one
+                break;
             }
         }
     }
 }
 
-void check_ship_on_asteroids() {
+/**
+ * @brief      Checks for collision between a ship and asteroids
+ *
+ * @param      s     The ship
+ */
+static void check_one_ship_on_asteroids(Ship *s) {
+    CollideBounds bounds;
+    uint32 mask[COLLIDE_MASK_WORDS];
+    float x[7];
+    float y[7];
+    float x1;
+    float y1;
+    float x2;
+    float y2;
     int32 i;
-    int8 lives;
+
+    if (!s->can_be_hit) {
+        return;
+    }
+
+    // Only asteroids whose box overlaps the ship's get an exact test
+    ship_get_base_points(s, x, y);
+    x1 = x2 = x[0];
+    y1 = y2 = y[0];
+    for (i = 1; i < 7; ++i) {
+        x1 = fminf(x1, x[i]);
+        y1 = fminf(y1, y[i]);
+        x2 = fmaxf(x2, x[i]);
+        y2 = fmaxf(y2, y[i]);
+    }
+
+    collide_gather_asteroids(&bounds);
+    if (!collide_query(&bounds, x1, y1, x2, y2, mask)) {
+        return;
+    }
 
     // For each asteroid
-    for (i = 0; i < num_asteroids; ++i) {
-        if (ship->can_be_hit && asteroid_check_collision_on_ship(asteroids[i], ship)) {
-            lives = ship_hit(ship);
+    for (i = collide_next(mask, num_asteroids, 0); i < num_asteroids;
+            i = collide_next(mask, num_asteroids, i + 1)) {
+        if (asteroid_check_collision_on_ship(asteroids[i], s)) {
+            CollisionEvent *event = &collision_events[num_collision_events++];
+
+            event->type = COLLISION_SHIP_ASTEROID;
+            event->blast = NULL;
+            event->ship = s;
+            event->asteroid = asteroids[i];
+
+            // One hit is all it takes
+            return;
+        }
+    }
+}
 
-            // Checks for game over
-            if (lives <= 0) {
-                game_over();
-            }
+void check_ship_on_asteroids() {
+    check_one_ship_on_asteroids(ship);
+    if (ship2) {
+        check_one_ship_on_asteroids(ship2);
+    }
+}
+
+void resolve_collisions() {
+    int32 i;
+
+    for (i = 0; i < num_collision_events; ++i) {
+        CollisionEvent *event = &collision_events[i];
+
+        switch (event->type) {
+            case COLLISION_BLAST_ASTEROID:
+                asteroid_was_hit(event->asteroid);
+                blast_delete(event->blast);
+                score_count += 100;
+                break;
+
+            case COLLISION_SHIP_ASTEROID:
+                if (ship_hit(event->ship) <= 0) {
+                    game_over();
+                }
+                break;
+        }
+    }
+    num_collision_events = 0;
+}
+
+/**
+ * @brief      Counts down a ship's invulnerability after being hit
+ *
+ * @param      s     The ship
+ */
+static void update_ship_hit_timer(Ship *s) {
+    if (!s->can_be_hit) {
+        ++(s->can_be_hit_count);
+        if (s->can_be_hit_count * sim_dt >= SHIP_INVULNERABLE_TIME) {
+            s->can_be_hit = true;
+            s->can_be_hit_count = 0;
         }
     }
 }
 
+void world_set_bounds(int32 width, int32 height) {
+    world_bounds.width = width;
+    world_bounds.height = height;
+    world_bounds.inv_width = (width > 0) ? 1.0f / width : 0.0f;
+    world_bounds.inv_height = (height > 0) ? 1.0f / height : 0.0f;
+}
+
 void game_over() {
     is_game_over = true;
 }
+
+void game_start() {
+    particle_clear();
+    ship_init();
+    asteroid_populate(5);
+
+    score_count = 0;
+    is_game_over = false;
+}
+
+void game_end() {
+    ship = ship_delete(ship);
+    ship2 = ship_delete(ship2);
+    blast_delete_all();
+    asteroid_delete_all();
+}
+
+void update_score_text() {
+    char msg[TEXT_MESSAGE_LENGTH] = {};
+
+    // Headless games have no score text to update
+    if (!score) {
+        return;
+    }
+
+    sprintf(msg, "Score: %d", score_count);
+    text_update_msg(score, msg);
+    score_shown = score_count;
+}
+
+void game_restart() {
+    game_end();
+    game_start();
+    update_score_text();
+}
+
+void game_tick() {
+    ++sim_tick;
+
+    // Move objects around
+    ship_move(ship);
+    if (ship2) {
+        ship_move(ship2);
+    }
+    blast_move_all();
+    asteroid_move_all();
+    asteroid_sort_spatial();
+
+    // Check for collision, then apply what was hit
+    check_blasts_on_asteroids();
+    check_ship_on_asteroids();
+    resolve_collisions();
+
+    update_ship_hit_timer(ship);
+    if (ship2) {
+        update_ship_hit_timer(ship2);
+    }
+}
+
+void fire_blast(Ship *shooter) {
+    if (num_blasts >= BLAST_MAX) {
+        return;
+    }
+
+    blast_make_new_default(shooter->x, shooter->y, shooter->direction);
+}
+
+/**
+ * @brief      splitmix64 finalizer, scrambles a 64-bit value
+ *
+ * @param[in]  z     The value
+ *
+ * @return     Scrambled value
+ */
+static uint64 sim_mix64(uint64 z) {
+    z += 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+void sim_seed(uint32 seed) {
+    sim_rng_seed = seed;
+    sim_tick = 0;
+}
+
+SimStream sim_stream(uint32 entity) {
+    SimStream stream;
+
+    // Squares wants an odd key with its bits spread around
+    stream.key = sim_mix64(((uint64)sim_rng_seed << 32) | entity) | 1u;
+    stream.counter = (uint64)sim_tick << 32;
+
+    return stream;
+}
+
+uint32 sim_stream_next(SimStream *stream) {
+    // Squares32 (Widynski): four rounds of squaring on counter * key
+    uint64 y = stream->counter++ * stream->key;
+    uint64 z = y + stream->key;
+    uint64 x = y;
+
+    x = x * x + y;
+    x = (x >> 32) | (x << 32);
+    x = x * x + z;
+    x = (x >> 32) | (x << 32);
+    x = x * x + y;
+    x = (x >> 32) | (x << 32);
+    return (uint32)((x * x + z) >> 32);
+}
+
+uint32 sim_child_id(uint32 parent, uint32 n) {
+    return (uint32)sim_mix64(((uint64)parent << 32) | n);
+}
+
+float sim_cos(float radians) {
+#ifdef WAS_FIXED_POINT
+    return fixed_to_float(fixed_cos(fixed_angle(radians)));
+#else
+    return (float)cos(radians);
+#endif // WAS_FIXED_POINT
+}
+
+float sim_sin(float radians) {
+#ifdef WAS_FIXED_POINT
+    return fixed_to_float(fixed_sin(fixed_angle(radians)));
+#else
+    return (float)sin(radians);
+#endif // WAS_FIXED_POINT
+}
+
+void sim_place(SimMotion *motion, float x, float y) {
+#ifdef WAS_FIXED_POINT
+    motion->x = fixed_from_float(x);
+    motion->y = fixed_from_float(y);
+#endif // WAS_FIXED_POINT
+    motion->stale = true;
+}
+
+void sim_advance(SimMotion *motion, float *x, float *y, float speed, float direction) {
+    // Asteroids and blasts never turn, so their step is worked out once
+    if (motion->stale || speed != motion->speed || direction != motion->direction) {
+#ifdef WAS_FIXED_POINT
+        int32 step = fixed_angle(direction);
+        fixed distance = fixed_from_float(speed);
+
+        motion->step_x = fixed_mul(distance, fixed_cos(step));
+        motion->step_y = -fixed_mul(distance, fixed_sin(step));
+#else
+        motion->step_x = speed * (float)cos(direction);
+        motion->step_y = -(speed * (float)sin(direction));
+#endif // WAS_FIXED_POINT
+        motion->speed = speed;
+        motion->direction = direction;
+        motion->stale = false;
+    }
+
+#ifdef WAS_FIXED_POINT
+    motion->x += motion->step_x;
+    motion->y += motion->step_y;
+    *x = fixed_to_float(motion->x);
+    *y = fixed_to_float(motion->y);
+#else
+    *x += motion->step_x;
+    *y += motion->step_y;
+#endif // WAS_FIXED_POINT
+}
@@ -0,0 +1,161 @@
+/*
+ *
+ * MIT License
+ * 
+ * Copyright (c) 2017 Wilk Maia
+ * wilkmaia [at] gmail [dot] com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ */
+
+
+/**
+ * Fixed-point functions
+ *
+ * 16.16 fixed-point numbers and table-based trigonometry. The sine table
+ * is built with integer arithmetic only, so it's bit-identical on every
+ * compiler and CPU, unlike libm's cos and sin.
+ */
+
+#define WAS_USING_FIXED
+#include "wasteroids.h"
+
+
+/*=========================================
+=            Local definitions            =
+=========================================*/
+
+#define QUARTER (FIXED_TRIG_STEPS / 4)
+
+/**
+ * pi/2 in 2.30 fixed-point
+ */
+#define HALF_PI_Q30 1686629713LL
+
+/**
+ * Sine over a quarter turn, both ends included
+ */
+static fixed sine_table[QUARTER + 1];
+
+/*=====  End of Local definitions  ======*/
+
+
+
+/**
+ * @brief      Builds the sine table. Must run before the simulation starts.
+ */
+void fixed_init() {
+    int32 i;
+
+    for (i = 0; i <= QUARTER; ++i) {
+        // Taylor series on 2.30 fixed-point, plenty of terms for [0, pi/2]
+        int64 x = HALF_PI_Q30 * i / QUARTER;
+        int64 term = x;
+        int64 sum = x;
+        int32 n;
+
+        for (n = 1; n <= 8; ++n) {
+            term = -((term * x) >> 30) * x >> 30;
+            term /= (2 * n) * (2 * n + 1);
+            sum += term;
+        }
+
+        sine_table[i] = (fixed)((sum + (1 << 13)) >> 14);
+    }
+}
+
+/**
+ * @brief      Converts a float to fixed-point, rounding to nearest
+ *
+ * @param[in]  v     The value
+ *
+ * @return     Fixed-point value
+ */
+fixed fixed_from_float(float v) {
+    return (fixed)lrintf(v * (float)FIXED_ONE);
+}
+
+/**
+ * @brief      Converts a fixed-point value to float
+ *
+ * @param[in]  v     The value
+ *
+ * @return     Float value
+ */
+float fixed_to_float(fixed v) {
+    return (float)v / (float)FIXED_ONE;
+}
+
+/**
+ * @brief      Multiplies two fixed-point values
+ *
+ * @param[in]  a     First factor
+ * @param[in]  b     Second factor
+ *
+ * @return     Product
+ */
+fixed fixed_mul(fixed a, fixed b) {
+    return (fixed)(((int64)a * b) >> FIXED_SHIFT);
+}
+
+/**
+ * @brief      Converts an angle to a step on the trig table
+ *
+ * @param[in]  radians  The angle
+ *
+ * @return     Step in [0, FIXED_TRIG_STEPS)
+ */
+int32 fixed_angle(float radians) {
+    return (int32)lrintf(radians * (float)(FIXED_TRIG_STEPS / (2.0 * ALLEGRO_PI)))
+           & (FIXED_TRIG_STEPS - 1);
+}
+
+/**
+ * @brief      Sine from the table
+ *
+ * @param[in]  step  Angle as a step, from fixed_angle
+ *
+ * @return     Fixed-point sine
+ */
+fixed fixed_sin(int32 step) {
+    int32 i = step & (QUARTER - 1);
+
+    switch ((step / QUARTER) & 3) {
+        case 0:
+            return sine_table[i];
+        case 1:
+            return sine_table[QUARTER - i];
+        case 2:
+            return -sine_table[i];
+        default:
+            return -sine_table[QUARTER - i];
+    }
+}
+
+/**
+ * @brief      Cosine from the table
+ *
+ * @param[in]  step  Angle as a step, from fixed_angle
+ *
+ * @return     Fixed-point cosine
+ */
+fixed fixed_cos(int32 step) {
+    return fixed_sin(step + QUARTER);
+}
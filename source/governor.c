@@ -0,0 +1,197 @@
+/*
+ *
+ * MIT License
+ * 
+ * Copyright (c) 2017 Wilk Maia
+ * wilkmaia [at] gmail [dot] com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ */
+
+
+/**
+ * Quality governor functions
+ *
+ * Watches how long each frame takes to simulate and draw against the
+ * frame budget, and steps render quality down when frames run over it
+ * and back up when there's plenty of headroom. Stepping down takes a
+ * short streak of slow frames; stepping up takes a long streak of fast
+ * ones, and after every change the governor waits for things to settle,
+ * so quality doesn't oscillate.
+ */
+
+#define WAS_USING_INPUT
+#define WAS_USING_SHIP
+#define WAS_USING_BLAST
+#define WAS_USING_ASTEROID
+#define WAS_USING_PARTICLE
+#define WAS_USING_GOVERNOR
+#define WAS_USING_RENDER
+#include "wasteroids.h"
+
+
+/*=========================================
+=            Local definitions            =
+=========================================*/
+
+typedef struct {
+    int32 particles;
+    int32 asteroid_vertices;
+    bool hairlines;
+    float render_scale;     // Of the scale the game started at
+} QualityLevel;
+
+/**
+ * From full quality down to cheapest
+ */
+static const QualityLevel LEVELS[] = {
+    { PARTICLE_MAX,      NUM_VERTICES,     false, 1.0f  },
+    { PARTICLE_MAX / 4,  NUM_VERTICES,     false, 1.0f  },
+    { PARTICLE_MAX / 16, 8,                false, 0.75f },
+    { 0,                 8,                true,  0.5f  }
+};
+#define NUM_LEVELS ((int32)(sizeof(LEVELS) / sizeof(LEVELS[0])))
+
+/**
+ * Frame cost, as a fraction of the budget, above which frames count as slow
+ * and below which they count as fast
+ */
+static const double SLOW_THRESHOLD = 0.85;
+static const double FAST_THRESHOLD = 0.5;
+
+/**
+ * Streaks needed to step quality down or up, and frames ignored after a step
+ */
+#define SLOW_FRAMES 15
+#define FAST_FRAMES 180
+#define SETTLE_FRAMES 60
+
+/**
+ * Weight of the newest frame on the smoothed cost
+ */
+static const double SMOOTHING = 0.1;
+
+static bool enabled = false;
+static int32 level;
+static double tick_time;
+static double average_cost;
+static int32 slow_streak;
+static int32 fast_streak;
+static int32 settle;
+
+/*=====  End of Local definitions  ======*/
+
+
+
+/**
+ * @brief      Applies the settings of the current quality level
+ */
+static void governor_apply() {
+    particle_set_draw_limit(LEVELS[level].particles);
+    asteroid_set_max_vertices(LEVELS[level].asteroid_vertices);
+    render_hairlines = LEVELS[level].hairlines;
+    render_set_scale(render_get_base_scale() * LEVELS[level].render_scale);
+
+    slow_streak = 0;
+    fast_streak = 0;
+    settle = SETTLE_FRAMES;
+}
+
+/**
+ * @brief      Starts the governor at full quality
+ */
+void governor_init() {
+    enabled = true;
+    level = 0;
+    tick_time = 0.0;
+    average_cost = 0.0;
+    governor_apply();
+}
+
+/**
+ * @brief      Checks if the governor is running
+ *
+ * @return     true if running; false otherwise
+ */
+bool governor_is_enabled() {
+    return enabled;
+}
+
+/**
+ * @brief      Gets the current quality level
+ *
+ * @return     0 for full quality, higher is cheaper
+ */
+int32 governor_get_level() {
+    return level;
+}
+
+/**
+ * @brief      Adds simulation time to the frame being measured
+ *
+ * @param[in]  seconds  Time spent on a tick
+ */
+void governor_record_tick(double seconds) {
+    tick_time += seconds;
+}
+
+/**
+ * @brief      Closes the frame being measured and adjusts quality if needed
+ *
+ * @param[in]  seconds  Time spent drawing the frame
+ */
+void governor_record_draw(double seconds) {
+    double budget = input_get_frame_period();
+    double cost = tick_time + seconds;
+
+    tick_time = 0.0;
+    if (!enabled) {
+        return;
+    }
+
+    average_cost += SMOOTHING * (cost - average_cost);
+
+    if (settle > 0) {
+        --settle;
+        return;
+    }
+
+    if (average_cost > SLOW_THRESHOLD * budget) {
+        ++slow_streak;
+        fast_streak = 0;
+    }
+    else if (average_cost < FAST_THRESHOLD * budget) {
+        ++fast_streak;
+        slow_streak = 0;
+    }
+    else {
+        slow_streak = 0;
+        fast_streak = 0;
+    }
+
+    if (slow_streak >= SLOW_FRAMES && level < NUM_LEVELS - 1) {
+        ++level;
+        governor_apply();
+    }
+    else if (fast_streak >= FAST_FRAMES && level > 0) {
+        --level;
+        governor_apply();
+    }
+}
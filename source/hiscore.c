@@ -30,8 +30,14 @@
  */
 
 #define WAS_USING_HISCORE
+#define WAS_USING_IO
 #include "wasteroids.h"
 
+/**
+ * Room for the saved high score file
+ */
+#define HISCORE_FILE_MAX 4096
+
 
 // Local global variables
 static int scores[NUM_SCORES] = {
@@ -83,6 +89,8 @@ void hiscore_init() {
 void hiscore_shutdown() {
     ALLEGRO_PATH *path;
     ALLEGRO_CONFIG *cfg;
+    ALLEGRO_FILE *file;
+    uint8 *contents;
     char buf1[256];
     int32 i;
 
@@ -109,7 +117,22 @@ void hiscore_shutdown() {
         set_config_string(cfg, "hiscore", buf1, names[i]);
     }
 
-    al_save_config_file(al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP), cfg);
+    // Saved to memory, and written out by the I/O worker
+    contents = (uint8 *)malloc(HISCORE_FILE_MAX);
+    file = al_open_memfile(contents, HISCORE_FILE_MAX, "w");
+    if (file && al_save_config_file_f(file, cfg)) {
+        size_t size = (size_t)al_ftell(file);
+
+        al_fclose(file);
+        io_write_file(al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP), contents, size);
+    }
+    else {
+        if (file) {
+            al_fclose(file);
+        }
+        free(contents);
+        fprintf(stderr, "High scores didn't fit in %d bytes, not saved\n", HISCORE_FILE_MAX);
+    }
 
     al_destroy_config(cfg);
     al_destroy_path(path);
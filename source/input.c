@@ -27,51 +27,234 @@
 
 /**
  * Input functions
+ *
+ * Keyboard events are read on a thread of their own, stamped, and pushed
+ * into a single-producer/single-consumer ring that the main thread drains
+ * at tick boundaries. Neither side ever blocks on the other, so a busy
+ * frame can't hold keystrokes back. The input thread also keeps the held
+ * steering keys in one word, for drawing with late-sampled input.
  */
 
 #define WAS_USING_INPUT
+#define WAS_USING_SHIP
+#define WAS_USING_PACER
 #include "wasteroids.h"
 
+/**
+ * The SYNC_ variants are sequentially consistent. Going idle stores idle then
+ * reads ring_head, pushing a key stores ring_head then reads idle; with plain
+ * acquire/release both loads could see the old value and the wake be lost.
+ */
+#if defined(_MSC_VER)
+    #include <intrin.h>
+    // Volatile accesses have acquire/release semantics on MSVC, and an
+    // interlocked exchange is a full barrier
+    #define RING_LOAD(p) (*(volatile uint32 *)(p))
+    #define RING_STORE(p, v) (*(volatile uint32 *)(p) = (v))
+    #define SYNC_LOAD(p) (*(volatile uint32 *)(p))
+    #define SYNC_STORE(p, v) ((void)_InterlockedExchange((volatile long *)(p), (long)(v)))
+#else
+    #define RING_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+    #define RING_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+    #define SYNC_LOAD(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+    #define SYNC_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#endif // _MSC_VER
+
+/**
+ * Key events the ring holds, a power of two. Events past that are dropped.
+ */
+#define INPUT_RING_SIZE 256
+
+/**
+ * How long the input thread sleeps between checks for shutdown
+ */
+#define INPUT_THREAD_POLL 0.05
+
+/**
+ * Sent by the input thread to wake an idle main thread up on a key
+ */
+#define INPUT_EVENT_WAKE ALLEGRO_GET_EVENT_TYPE('W', 'A', 'S', 'K')
+
 
 // Local global variables
-static int32 keybuf_len = 0;
-static ALLEGRO_MUTEX *keybuf_mutex;
 static ALLEGRO_EVENT_QUEUE *input_queue;
-static ALLEGRO_TIMER *timer;
-static float FPS = 60.0f;
+static ALLEGRO_EVENT_QUEUE *key_queue;
+static ALLEGRO_THREAD *input_thread;
+static InputKey ring[INPUT_RING_SIZE];
+static uint32 ring_head = 0;    // Written by the input thread only
+static uint32 ring_tail = 0;    // Written by the main thread only
+static uint32 ring_dropped = 0;
+static uint32 live_controls = 0;
+static uint32 idle = 0;         // Written by the main thread only
+static ALLEGRO_EVENT_SOURCE wake_source;
+static ALLEGRO_TIMER *timer = NULL;
+static ALLEGRO_TIMER *frame_timer = NULL;
+static double tick_rate = SIM_DEFAULT_TICK_RATE;
+static double fps_cap = -1.0;   // Below 0: a frame per tick; 0: uncapped
+
+// Latency probe: time from a key press to the flip of the first frame showing it
+static bool probe_enabled = false;
+static bool probe_pending = false;
+static bool probe_needs_tick = false;
+static double probe_key_time = 0.0;
+static int32 probe_samples = 0;
+static double probe_total = 0.0;
+static double probe_min = 0.0;
+static double probe_max = 0.0;
+
+/**
+ * @brief      Maps a steering key to its SHIP_INPUT_* bit
+ *
+ * @param[in]  keycode  The key
+ *
+ * @return     The bit, or 0 for other keys
+ */
+static uint32 input_control_bit(int32 keycode) {
+    switch (keycode) {
+        case ALLEGRO_KEY_LEFT:
+            return SHIP_INPUT_LEFT;
+        case ALLEGRO_KEY_RIGHT:
+            return SHIP_INPUT_RIGHT;
+        case ALLEGRO_KEY_UP:
+            return SHIP_INPUT_THRUST;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief      Input thread: moves keyboard events into the ring
+ *
+ * @param      thread  The thread
+ * @param      arg     Unused
+ *
+ * @return     NULL
+ */
+static void * input_thread_run(ALLEGRO_THREAD *thread, void *arg) {
+    ALLEGRO_EVENT ev;
+
+    while (!al_get_thread_should_stop(thread)) {
+        uint32 head;
+        InputKey *key;
+
+        if (!al_wait_for_event_timed(key_queue, &ev, INPUT_THREAD_POLL)) {
+            continue;
+        }
+        if (ev.type != ALLEGRO_EVENT_KEY_DOWN && ev.type != ALLEGRO_EVENT_KEY_UP) {
+            continue;
+        }
+
+        // Only this thread writes it, so a plain read of the controls is fine
+        if (ev.type == ALLEGRO_EVENT_KEY_DOWN) {
+            RING_STORE(&live_controls, live_controls | input_control_bit(ev.keyboard.keycode));
+        }
+        else {
+            RING_STORE(&live_controls, live_controls & ~input_control_bit(ev.keyboard.keycode));
+        }
+
+        // Full ring: drop rather than wait on the consumer
+        head = ring_head;
+        if (head - RING_LOAD(&ring_tail) >= INPUT_RING_SIZE) {
+            ++ring_dropped;
+            continue;
+        }
+
+        key = &ring[head & (INPUT_RING_SIZE - 1)];
+        key->down = ev.type == ALLEGRO_EVENT_KEY_DOWN;
+        key->keycode = ev.keyboard.keycode;
+        key->timestamp = ev.keyboard.timestamp;
+        SYNC_STORE(&ring_head, head + 1);
+
+        // An idle main thread blocks on its queue and won't look at the ring
+        if (SYNC_LOAD(&idle)) {
+            ALLEGRO_EVENT wake;
+
+            wake.user.type = INPUT_EVENT_WAKE;
+            al_emit_user_event(&wake_source, &wake, NULL);
+        }
+    }
+
+    return NULL;
+}
 
 /**
  * @brief      Initialise input service
  */
 void input_init() {
-    keybuf_len = 0;
-    keybuf_mutex = al_create_mutex();
-    
-    timer = al_create_timer(1.0 / FPS);
-    if (!timer) {
-        error("Failed to create timer");
+    // The pacer has its own deadlines, and needs no tick timer
+    if (!pacer_is_enabled()) {
+        timer = al_create_timer(1.0 / tick_rate);
+        if (!timer) {
+            error("Failed to create timer");
+        }
+        al_start_timer(timer);
+    }
+
+    // Frames get their own timer when capped at a rate of their own
+    if (fps_cap > 0.0) {
+        frame_timer = al_create_timer(1.0 / fps_cap);
+        if (!frame_timer) {
+            error("Failed to create frame timer");
+        }
+        al_start_timer(frame_timer);
     }
-    al_start_timer(timer);
 
     // Registers input queue
     input_queue = al_create_event_queue();
-    al_register_event_source(input_queue, al_get_keyboard_event_source());
     al_register_event_source(input_queue, al_get_display_event_source(screen));
-    al_register_event_source(input_queue, al_get_timer_event_source(timer));
+    if (timer) {
+        al_register_event_source(input_queue, al_get_timer_event_source(timer));
+    }
+    if (frame_timer) {
+        al_register_event_source(input_queue, al_get_timer_event_source(frame_timer));
+    }
+    al_init_user_event_source(&wake_source);
+    al_register_event_source(input_queue, &wake_source);
+    idle = 0;
+
+    // Keyboard goes through the input thread
+    ring_head = 0;
+    ring_tail = 0;
+    ring_dropped = 0;
+    live_controls = 0;
+    key_queue = al_create_event_queue();
+    al_register_event_source(key_queue, al_get_keyboard_event_source());
+
+    input_thread = al_create_thread(input_thread_run, NULL);
+    if (!input_thread) {
+        error("Failed to create input thread");
+    }
+    al_start_thread(input_thread);
 }
 
 /**
  * @brief      Cleanup for input service
  */
 void input_shutdown() {
-    al_destroy_mutex(keybuf_mutex);
-    keybuf_mutex = NULL;
+    // Joins the input thread before its queue goes away
+    al_destroy_thread(input_thread);
+    input_thread = NULL;
+
+    al_destroy_event_queue(key_queue);
+    key_queue = NULL;
+
+    if (ring_dropped > 0) {
+        fprintf(stderr, "Input ring overflowed, %u key events dropped\n", ring_dropped);
+    }
 
     al_destroy_event_queue(input_queue);
     input_queue = NULL;
+    al_destroy_user_event_source(&wake_source);
 
-    al_destroy_timer(timer);
-    timer = NULL;
+    if (timer) {
+        al_destroy_timer(timer);
+        timer = NULL;
+    }
+
+    if (frame_timer) {
+        al_destroy_timer(frame_timer);
+        frame_timer = NULL;
+    }
 }
 
 /**
@@ -83,6 +266,46 @@ void input_wait_for_event(ALLEGRO_EVENT *ev) {
     al_wait_for_event(input_queue, ev);
 }
 
+/**
+ * @brief      Takes the next event without waiting
+ *
+ * @param      ev    pointer to ALLEGRO_EVENT
+ *
+ * @return     true if there was an event; false if the queue is empty
+ */
+bool input_get_next_event(ALLEGRO_EVENT *ev) {
+    return al_get_next_event(input_queue, ev);
+}
+
+/**
+ * @brief      Takes the oldest key event off the ring. Main thread only.
+ *
+ * @param[out] key   The key event
+ *
+ * @return     true if there was one; false if the ring is empty
+ */
+bool input_next_key(InputKey *key) {
+    uint32 tail = ring_tail;
+
+    if (tail == SYNC_LOAD(&ring_head)) {
+        return false;
+    }
+
+    *key = ring[tail & (INPUT_RING_SIZE - 1)];
+    RING_STORE(&ring_tail, tail + 1);
+
+    return true;
+}
+
+/**
+ * @brief      Gets the steering keys held right now, ahead of the ring
+ *
+ * @return     SHIP_INPUT_* bits
+ */
+uint8 input_get_live_controls() {
+    return (uint8)RING_LOAD(&live_controls);
+}
+
 /**
  * @brief      Checks if event queue is empty
  *
@@ -91,3 +314,201 @@ void input_wait_for_event(ALLEGRO_EVENT *ev) {
 bool input_is_queue_empty() {
     return al_is_event_queue_empty(input_queue);
 }
+
+/**
+ * @brief      Gets the time between two simulation ticks, which is also the frame budget
+ *
+ * @return     Period in seconds
+ */
+double input_get_tick_period() {
+    return 1.0 / tick_rate;
+}
+
+/**
+ * @brief      Gets the time a frame has to be drawn in
+ *
+ * @return     Period in seconds
+ */
+double input_get_frame_period() {
+    return (fps_cap > 0.0) ? 1.0 / fps_cap : 1.0 / tick_rate;
+}
+
+/**
+ * @brief      Sets the tick and frame rates. Must run before input_init.
+ *
+ * @param[in]  ticks_per_second   Simulation tick rate
+ * @param[in]  frames_per_second  Frame cap, 0 for uncapped, below 0 for a frame per tick
+ */
+void input_set_rates(double ticks_per_second, double frames_per_second) {
+    tick_rate = ticks_per_second;
+    fps_cap = frames_per_second;
+    sim_dt = (float)(1.0 / ticks_per_second);
+}
+
+/**
+ * @brief      Stops or restarts the timers. While idle, keys wake the main
+ *             thread up through its event queue, and stale timer events
+ *             are ignored. Keys pushed right before going idle send no
+ *             wake, so the caller drains the ring once more before blocking.
+ *
+ * @param[in]  on    true to go idle
+ */
+void input_set_idle(bool on) {
+    if (on == (idle != 0)) {
+        return;
+    }
+
+    SYNC_STORE(&idle, on ? 1 : 0);
+    if (on) {
+        if (timer) {
+            al_stop_timer(timer);
+        }
+        if (frame_timer) {
+            al_stop_timer(frame_timer);
+        }
+    }
+    else {
+        if (timer) {
+            al_start_timer(timer);
+        }
+        if (frame_timer) {
+            al_start_timer(frame_timer);
+        }
+    }
+}
+
+/**
+ * @brief      Checks if the timers are stopped
+ *
+ * @return     true if idle; false otherwise
+ */
+bool input_is_idle() {
+    return idle != 0;
+}
+
+/**
+ * @brief      Checks if an event is a simulation tick
+ *
+ * @param      ev    The event
+ *
+ * @return     true if so; false otherwise
+ */
+bool input_is_tick(const ALLEGRO_EVENT *ev) {
+    return !idle && ev->type == ALLEGRO_EVENT_TIMER && ev->timer.source == timer;
+}
+
+/**
+ * @brief      Checks if an event means a frame is due
+ *
+ * @param      ev    The event
+ *
+ * @return     true if so; false otherwise
+ */
+bool input_is_frame(const ALLEGRO_EVENT *ev) {
+    if (idle || ev->type != ALLEGRO_EVENT_TIMER) {
+        return false;
+    }
+
+    return frame_timer ? ev->timer.source == frame_timer
+                       : (fps_cap < 0.0 && ev->timer.source == timer);
+}
+
+/**
+ * @brief      Checks if frames are drawn as fast as possible
+ *
+ * @return     true if uncapped; false otherwise
+ */
+bool input_is_uncapped() {
+    return fps_cap == 0.0;
+}
+
+/**
+ * @brief      Gets the ship controls currently held on the keyboard
+ *
+ * @return     SHIP_INPUT_* bits
+ */
+uint8 input_get_controls() {
+    uint8 controls = 0;
+
+    if (pressed_keys[ALLEGRO_KEY_LEFT]) {
+        controls |= SHIP_INPUT_LEFT;
+    }
+    if (pressed_keys[ALLEGRO_KEY_RIGHT]) {
+        controls |= SHIP_INPUT_RIGHT;
+    }
+    if (pressed_keys[ALLEGRO_KEY_UP]) {
+        controls |= SHIP_INPUT_THRUST;
+    }
+
+    return controls;
+}
+
+/**
+ * @brief      Starts measuring input latency
+ */
+void input_probe_enable() {
+    probe_enabled = true;
+}
+
+/**
+ * @brief      Stamps a key press, unless one is still waiting to be shown
+ *
+ * @param[in]  timestamp  Event time, on al_get_time's clock
+ * @param[in]  needs_tick true if the press only shows after a simulation tick
+ */
+void input_probe_key(double timestamp, bool needs_tick) {
+    if (!probe_enabled || probe_pending) {
+        return;
+    }
+
+    probe_pending = true;
+    probe_needs_tick = needs_tick;
+    probe_key_time = timestamp;
+}
+
+/**
+ * @brief      Tells the probe a simulation tick ran
+ */
+void input_probe_tick() {
+    probe_needs_tick = false;
+}
+
+/**
+ * @brief      Tells the probe a frame was flipped, which completes a waiting press
+ */
+void input_probe_frame_shown() {
+    double latency;
+
+    if (!probe_pending || probe_needs_tick) {
+        return;
+    }
+
+    latency = al_get_time() - probe_key_time;
+    if (probe_samples == 0 || latency < probe_min) {
+        probe_min = latency;
+    }
+    if (probe_samples == 0 || latency > probe_max) {
+        probe_max = latency;
+    }
+    probe_total += latency;
+    ++probe_samples;
+    probe_pending = false;
+}
+
+/**
+ * @brief      Prints what the probe measured
+ */
+void input_probe_report() {
+    if (!probe_enabled) {
+        return;
+    }
+
+    if (probe_samples == 0) {
+        printf("Input latency: no key presses measured\n");
+        return;
+    }
+
+    printf("Input latency over %d presses: min %.1f ms, avg %.1f ms, max %.1f ms\n",
+           probe_samples, probe_min * 1000.0, probe_total * 1000.0 / probe_samples,
+           probe_max * 1000.0);
+}
@@ -0,0 +1,402 @@
+/*
+ *
+ * MIT License
+ * 
+ * Copyright (c) 2017 Wilk Maia
+ * wilkmaia [at] gmail [dot] com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ */
+
+
+
+/**
+ * Background file I/O functions
+ *
+ * One worker thread writes files off a bounded queue, so the game loop
+ * never waits on the disk. Each write goes to a temporary file that is
+ * synced and then renamed over the target, so a crash leaves either the
+ * old file or the new one, never half of one. A full queue drops the
+ * write, and a write that takes too long is reported, both as warnings
+ * rather than stalls. Reads of a file with a write still queued get the
+ * queued contents instead of waiting for them to land.
+ */
+
+#define WAS_USING_IO
+#include "wasteroids.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+
+/*=========================================
+=            Local definitions            =
+=========================================*/
+
+/**
+ * Writes that can wait at once
+ */
+#define IO_QUEUE_SIZE 16
+
+/**
+ * Seconds a write may take before it's reported as stalled
+ */
+#define IO_STALL_WARNING 2.0
+
+/**
+ * Seconds shutdown waits for queued writes to land
+ */
+#define IO_SHUTDOWN_TIMEOUT 5.0
+
+typedef struct {
+    char *path;
+    uint8 *data;
+    size_t size;
+} IoJob;
+
+// Everything below is guarded by mutex
+static IoJob queue[IO_QUEUE_SIZE];
+static int32 queue_head = 0;
+static int32 queue_count = 0;
+static double busy_since = 0.0;     // Start of the write in progress, 0 when idle
+static bool stall_reported = false;
+
+static ALLEGRO_THREAD *io_thread = NULL;
+static ALLEGRO_MUTEX *mutex = NULL;
+static ALLEGRO_COND *cond = NULL;
+
+/**
+ * @brief      Writes a whole buffer to a file descriptor
+ *
+ * @return     true on success; false otherwise
+ */
+static bool io_write_all(int fd, const uint8 *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        size -= (size_t)n;
+    }
+
+    return true;
+}
+
+/**
+ * @brief      Syncs the directory a file is in, so a rename in it is durable
+ *
+ * @param[in]  path  The file
+ */
+static void io_sync_directory(const char *path) {
+    const char *slash = strrchr(path, '/');
+    char *dir;
+    int fd;
+
+    if (!slash) {
+        dir = (char *)malloc(2);
+        strcpy(dir, ".");
+    }
+    else {
+        size_t length = (slash == path) ? 1 : (size_t)(slash - path);
+
+        dir = (char *)malloc(length + 1);
+        memcpy(dir, path, length);
+        dir[length] = 0;
+    }
+
+    fd = open(dir, O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+
+    free(dir);
+}
+
+/**
+ * @brief      Writes a file through a synced temporary and a rename
+ *
+ * @param[in]  path  The file
+ * @param[in]  data  Contents
+ * @param[in]  size  Contents size
+ *
+ * @return     true on success; false otherwise (errno tells why)
+ */
+static bool io_write_now(const char *path, const uint8 *data, size_t size) {
+    size_t length = strlen(path);
+    char *tmp = (char *)malloc(length + 5);
+    bool ok;
+    int fd;
+
+    memcpy(tmp, path, length);
+    memcpy(tmp + length, ".tmp", 5);
+
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        free(tmp);
+        return false;
+    }
+
+    ok = io_write_all(fd, data, size) && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    ok = ok && rename(tmp, path) == 0;
+
+    if (ok) {
+        io_sync_directory(path);
+    }
+    else {
+        int saved = errno;
+
+        unlink(tmp);
+        errno = saved;
+    }
+
+    free(tmp);
+
+    return ok;
+}
+
+/**
+ * @brief      Worker thread: writes queued files until told to stop and
+ *             the queue is empty
+ *
+ * @param      thread  The thread
+ * @param      arg     Unused
+ *
+ * @return     NULL
+ */
+static void * io_thread_run(ALLEGRO_THREAD *thread, void *arg) {
+    al_lock_mutex(mutex);
+    while (true) {
+        IoJob job;
+
+        while (queue_count == 0 && !al_get_thread_should_stop(thread)) {
+            al_wait_cond(cond, mutex);
+        }
+        if (queue_count == 0) {
+            break;
+        }
+
+        job = queue[queue_head];
+        busy_since = al_get_time();
+        stall_reported = false;
+        al_unlock_mutex(mutex);
+
+        if (!io_write_now(job.path, job.data, job.size)) {
+            fprintf(stderr, "Failed to write %s: %s\n", job.path, strerror(errno));
+        }
+
+        // Readers may be copying the job until it leaves the queue
+        al_lock_mutex(mutex);
+        queue_head = (queue_head + 1) % IO_QUEUE_SIZE;
+        --queue_count;
+        busy_since = 0.0;
+        free(job.path);
+        free(job.data);
+        al_broadcast_cond(cond);
+    }
+    al_unlock_mutex(mutex);
+
+    return NULL;
+}
+
+/**
+ * @brief      Waits for every queued write to land. Mutex must be held.
+ *
+ * @param[in]  timeout  Seconds to wait at most
+ *
+ * @return     true if the queue emptied; false on timeout
+ */
+static bool io_wait_idle(double timeout) {
+    ALLEGRO_TIMEOUT until;
+
+    al_init_timeout(&until, timeout);
+    while (queue_count > 0) {
+        if (al_wait_cond_until(cond, mutex, &until) != 0) {
+            return queue_count == 0;
+        }
+    }
+
+    return true;
+}
+
+/*=====  End of Local definitions  ======*/
+
+
+
+/**
+ * @brief      Starts the I/O worker
+ */
+void io_init() {
+    mutex = al_create_mutex();
+    cond = al_create_cond();
+    queue_head = 0;
+    queue_count = 0;
+    busy_since = 0.0;
+
+    io_thread = al_create_thread(io_thread_run, NULL);
+    if (!mutex || !cond || !io_thread) {
+        error("Failed to start the I/O worker");
+    }
+    al_start_thread(io_thread);
+}
+
+/**
+ * @brief      Lets queued writes land, for a while, and stops the worker
+ */
+void io_shutdown() {
+    bool drained;
+
+    if (!io_thread) {
+        return;
+    }
+
+    al_lock_mutex(mutex);
+    drained = io_wait_idle(IO_SHUTDOWN_TIMEOUT);
+    if (drained) {
+        al_set_thread_should_stop(io_thread);
+        al_broadcast_cond(cond);
+    }
+    else {
+        fprintf(stderr, "Disk stalled, %d writes never finished\n", queue_count);
+    }
+    al_unlock_mutex(mutex);
+
+    // A stuck worker is left behind rather than hanging the exit
+    if (!drained) {
+        return;
+    }
+
+    al_destroy_thread(io_thread);
+    io_thread = NULL;
+    al_destroy_cond(cond);
+    cond = NULL;
+    al_destroy_mutex(mutex);
+    mutex = NULL;
+}
+
+/**
+ * @brief      Queues a file write. Never waits on the disk.
+ *
+ * @param[in]  path  The file, copied
+ * @param      data  Contents, from malloc. The I/O worker owns it from here
+ *                   on and frees it, whatever the outcome.
+ * @param[in]  size  Contents size
+ *
+ * @return     true if queued, or written when there's no worker; false otherwise
+ */
+bool io_write_file(const char *path, uint8 *data, size_t size) {
+    size_t length = strlen(path);
+    IoJob *job;
+
+    // Without a worker, such as in headless runs, it's written right away
+    if (!io_thread) {
+        bool ok = io_write_now(path, data, size);
+
+        free(data);
+        return ok;
+    }
+
+    al_lock_mutex(mutex);
+    if (queue_count == IO_QUEUE_SIZE) {
+        al_unlock_mutex(mutex);
+        fprintf(stderr, "I/O queue full, dropped write of %s\n", path);
+        free(data);
+        return false;
+    }
+
+    job = &queue[(queue_head + queue_count) % IO_QUEUE_SIZE];
+    job->path = (char *)malloc(length + 1);
+    memcpy(job->path, path, length + 1);
+    job->data = data;
+    job->size = size;
+    ++queue_count;
+    al_broadcast_cond(cond);
+    al_unlock_mutex(mutex);
+
+    return true;
+}
+
+/**
+ * @brief      Gets the contents of the newest write to a file that hasn't
+ *             landed yet. Never waits on the disk.
+ *
+ * @param[in]  path  The file
+ * @param[out] size  Contents size
+ *
+ * @return     Copy of the contents, to be freed by the caller; NULL if no
+ *             write to path is queued, so the file itself is up to date
+ */
+uint8 * io_read_pending(const char *path, size_t *size) {
+    uint8 *data = NULL;
+    int32 i;
+
+    if (!io_thread) {
+        return NULL;
+    }
+
+    al_lock_mutex(mutex);
+    for (i = queue_count - 1; i >= 0; --i) {
+        IoJob *job = &queue[(queue_head + i) % IO_QUEUE_SIZE];
+
+        if (strcmp(job->path, path) == 0) {
+            data = (uint8 *)malloc(job->size ? job->size : 1);
+            if (data) {
+                memcpy(data, job->data, job->size);
+                *size = job->size;
+            }
+            break;
+        }
+    }
+    al_unlock_mutex(mutex);
+
+    return data;
+}
+
+/**
+ * @brief      Warns, once per write, when the write in progress is taking
+ *             too long. Cheap enough to call every tick.
+ */
+void io_check_stall() {
+    double stalled = 0.0;
+    int32 pending = 0;
+
+    if (!io_thread) {
+        return;
+    }
+
+    al_lock_mutex(mutex);
+    if (busy_since > 0.0 && !stall_reported
+            && al_get_time() - busy_since > IO_STALL_WARNING) {
+        stalled = al_get_time() - busy_since;
+        pending = queue_count;
+        stall_reported = true;
+    }
+    al_unlock_mutex(mutex);
+
+    if (stalled > 0.0) {
+        fprintf(stderr, "Disk write stalled for %.1f s, %d writes queued\n", stalled, pending);
+    }
+}
@@ -41,17 +41,57 @@
 #define WAS_USING_BLAST
 #define WAS_USING_ASTEROID
 #define WAS_USING_TEXT
+#define WAS_USING_BATCH
+#define WAS_USING_AUTOPILOT
+#define WAS_USING_SOAK
+#define WAS_USING_NETPLAY
+#define WAS_USING_SPECTATE
+#define WAS_USING_PARTICLE
+#define WAS_USING_GOVERNOR
+#define WAS_USING_COLLIDE
+#define WAS_USING_FIXED
+#define WAS_USING_PACER
+#define WAS_USING_RENDER
+#define WAS_USING_STARTUP
+#define WAS_USING_IO
 #include "wasteroids.h"
 
 
+/**
+ * @brief      Startup job: precomputed trig, shape and collision tables
+ */
+static void load_tables() {
+    fixed_init();
+    asteroid_shapes_init();
+    collide_init();
+}
+
+
  int main(int argc, char *argv[]) {
     int8 i;
     int32 display_flags;
     int32 n;
     int32 width;
     int32 height;
+    int32 batch_games;
+    int32 font_loads;
+    double soak_hours;
+    int32 host_port;
+    const char *join_address;
+    int32 net_latency;
+    int32 net_loss;
+    int32 broadcast_port;
+    const char *spectate_address;
+    bool use_governor;
+    double tick_rate;
+    double fps_cap;
+    int32 vsync;
+    bool use_pacer;
+    int32 pin_core;
+    float render_scale;
 
     srand((unsigned int)time(NULL));
+    sim_seed((uint32)time(NULL));
 
     /*==========================================
     =            Initialise Allegro            =
@@ -62,6 +102,11 @@
     if (!al_init()) {
         error("Couldn't initialise Allegro");
     }
+
+    // Work that needs nothing else runs while the rest comes up
+    startup_begin();
+    startup_run("tables", load_tables);
+    startup_run("hiscore", hiscore_init);
     
     if (!al_init_primitives_addon()) {
         error("Couldn't initialise Allegro Primitives Addon");
@@ -75,9 +120,27 @@
         error("Couldn't initialise Allegro Image Addon");
     }
 
-    display_flags = ALLEGRO_GENERATE_EXPOSE_EVENTS;
+    startup_run("fonts", text_preload_default_font);
+
+    display_flags = ALLEGRO_GENERATE_EXPOSE_EVENTS | ALLEGRO_RESIZABLE;
     width = 0;
     height = 0;
+    batch_games = 0;
+    font_loads = 0;
+    soak_hours = 0.0;
+    host_port = 0;
+    join_address = NULL;
+    net_latency = 0;
+    net_loss = 0;
+    broadcast_port = 0;
+    spectate_address = NULL;
+    use_governor = true;
+    tick_rate = SIM_DEFAULT_TICK_RATE;
+    fps_cap = -1.0;
+    vsync = 0;
+    use_pacer = false;
+    pin_core = -1;
+    render_scale = 1.0f;
 
 
     /*============================================
@@ -87,6 +150,124 @@
         if (strcmp(argv[i], "--fullscreen") == 0) {
             display_flags |= ALLEGRO_FULLSCREEN_WINDOW;
         }
+        else if (strcmp(argv[i], "--autopilot") == 0) {
+            autopilot_enabled = true;
+        }
+        else if (strcmp(argv[i], "--soak") == 0 && i + 1 < argc) {
+            soak_hours = atof(argv[++i]);
+
+            if (soak_hours <= 0.0) {
+                print_usage_message();
+                return -1;
+            }
+
+            autopilot_enabled = true;
+        }
+        else if (strcmp(argv[i], "--host") == 0 && i + 1 < argc) {
+            host_port = atoi(argv[++i]);
+
+            if (host_port <= 0) {
+                print_usage_message();
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--join") == 0 && i + 1 < argc) {
+            join_address = argv[++i];
+        }
+        else if (strcmp(argv[i], "--net-latency") == 0 && i + 1 < argc) {
+            net_latency = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--net-loss") == 0 && i + 1 < argc) {
+            net_loss = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--broadcast") == 0 && i + 1 < argc) {
+            broadcast_port = atoi(argv[++i]);
+
+            if (broadcast_port <= 0) {
+                print_usage_message();
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--spectate") == 0 && i + 1 < argc) {
+            spectate_address = argv[++i];
+        }
+        else if (strcmp(argv[i], "--no-governor") == 0) {
+            use_governor = false;
+        }
+        else if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc) {
+            tick_rate = atof(argv[++i]);
+
+            if (tick_rate <= 0.0) {
+                print_usage_message();
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--fps-cap") == 0 && i + 1 < argc) {
+            fps_cap = atof(argv[++i]);
+
+            if (fps_cap < 0.0) {
+                print_usage_message();
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--vsync") == 0 && i + 1 < argc) {
+            ++i;
+
+            // Allegro: 1 forces vsync on, 2 forces it off, 0 leaves it to the driver
+            if (strcmp(argv[i], "on") == 0) {
+                vsync = 1;
+            }
+            else if (strcmp(argv[i], "off") == 0) {
+                vsync = 2;
+            }
+            else {
+                print_usage_message();
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--render-scale") == 0 && i + 1 < argc) {
+            render_scale = (float)atof(argv[++i]);
+
+            if (render_scale < RENDER_SCALE_MIN || render_scale > 1.0f) {
+                print_usage_message();
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--pacer") == 0) {
+            use_pacer = true;
+        }
+        else if (strcmp(argv[i], "--pin-core") == 0 && i + 1 < argc) {
+            pin_core = atoi(argv[++i]);
+
+            if (pin_core < 0) {
+                print_usage_message();
+                return -1;
+            }
+
+            use_pacer = true;
+        }
+        else if (strcmp(argv[i], "--latency-probe") == 0) {
+            input_probe_enable();
+        }
+        else if (strcmp(argv[i], "--startup-report") == 0) {
+            startup_enable_report();
+        }
+        else if (strcmp(argv[i], "--asset-bench") == 0 && i + 1 < argc) {
+            font_loads = atoi(argv[++i]);
+
+            if (font_loads <= 0) {
+                print_usage_message();
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--batch-bench") == 0 && i + 1 < argc) {
+            batch_games = atoi(argv[++i]);
+
+            if (batch_games <= 0) {
+                print_usage_message();
+                return -1;
+            }
+        }
         else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
             print_usage_message();
             return -1;
@@ -112,6 +293,32 @@
         }
     }
 
+    // The pacer draws a frame per tick, and has no separate frame rate
+    if (use_pacer && fps_cap >= 0.0) {
+        print_usage_message();
+        return -1;
+    }
+
+
+    /*==========================================
+    =            Headless benchmark            =
+    ==========================================*/
+    if (batch_games > 0 || font_loads > 0) {
+        startup_wait();
+        if (batch_games > 0) {
+            batch_benchmark(batch_games, 10000);
+        }
+        if (font_loads > 0) {
+            text_benchmark_font(font_loads);
+        }
+
+        al_shutdown_primitives_addon();
+        al_shutdown_font_addon();
+        al_shutdown_image_addon();
+
+        return 0;
+    }
+
 
     /*=========================================
     =            New Display Setup            =
@@ -126,6 +333,7 @@
 
     al_set_new_display_option(ALLEGRO_SAMPLE_BUFFERS, 1, ALLEGRO_SUGGEST);
     al_set_new_display_option(ALLEGRO_SAMPLES, 4, ALLEGRO_SUGGEST);
+    al_set_new_display_option(ALLEGRO_VSYNC, vsync, ALLEGRO_SUGGEST);
     al_set_new_display_flags(display_flags);
 
     // Attempts to create the display object
@@ -136,6 +344,11 @@
         error(buf);
     }
 
+    // Simulation runs on the display's dimensions
+    world_set_bounds(al_get_display_width(screen), al_get_display_height(screen));
+    render_init(render_scale);
+    startup_display_ready();
+
     // Hide mouse if in fullscreen mode
     if (display_flags & ALLEGRO_FULLSCREEN_WINDOW) {
         al_hide_mouse_cursor(screen);
@@ -147,22 +360,53 @@
     ====================================*/
     al_install_keyboard();
 
+    input_set_rates(tick_rate, fps_cap);
+    if (use_pacer) {
+        pacer_init(1.0 / tick_rate, pin_core);
+    }
     input_init();
-    hiscore_init();
+    io_init();
+
+    // Everything past here needs the workers' results
+    startup_wait();
 
 
     /*====================================
     =            Game objects            =
     ====================================*/
-    // Ship
-    ship_init();
+    // Ship and asteroids
+    particle_set_enabled(true);
+    game_start();
 
-    // Asteroids
-    asteroid_populate(5);
+    // Render quality
+    if (use_governor) {
+        governor_init();
+    }
 
     // Text
     score = text_make_new_default(3, 100, 100, "Score: ");
-    score_count = 0;
+
+    // Soak test
+    if (soak_hours > 0.0) {
+        soak_init(soak_hours);
+    }
+
+    // Two-player game
+    if (host_port > 0) {
+        netplay_host(host_port);
+    }
+    else if (join_address) {
+        netplay_join(join_address);
+    }
+    netplay_set_conditions(net_latency, net_loss);
+
+    // Spectators
+    if (broadcast_port > 0) {
+        spectate_broadcast_init(broadcast_port);
+    }
+    else if (spectate_address) {
+        spectate_join(spectate_address);
+    }
 
 
     /*=================================
@@ -174,12 +418,17 @@
     /*============================================
     =            Game objects cleanup            =
     ============================================*/
-    ship_delete(ship);
+    soak_shutdown();
+    netplay_shutdown();
+    spectate_shutdown();
+    game_end();
     text_delete(score);
-    blast_delete_all();
-    asteroid_delete_all();
     hiscore_shutdown();
+    input_probe_report();
+    pacer_report();
     input_shutdown();
+    render_shutdown();
+    io_shutdown();
 
 
     /*=======================================
@@ -0,0 +1,623 @@
+/*
+ *
+ * MIT License
+ * 
+ * Copyright (c) 2017 Wilk Maia
+ * wilkmaia [at] gmail [dot] com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ */
+
+
+/**
+ * Netplay functions
+ *
+ * Two-player co-op over UDP with rollback. Peers only exchange inputs:
+ * the host flies the first ship and the guest the second one. Every tick
+ * each peer simulates with its own input and a prediction of the remote
+ * one (the last input it got), keeping a snapshot of the world before each
+ * tick. When a remote input arrives that differs from what was predicted,
+ * the world is restored to the snapshot of that tick and the ticks since
+ * are simulated again.
+ *
+ * Latency and packet loss can be simulated on outgoing packets, so two
+ * instances on localhost are enough to test it.
+ */
+
+#define WAS_USING_SHIP
+#define WAS_USING_BLAST
+#define WAS_USING_ASTEROID
+#define WAS_USING_INPUT
+#define WAS_USING_SNAPSHOT
+#define WAS_USING_NETPLAY
+#define WAS_USING_PARTICLE
+#include "wasteroids.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+/*=========================================
+=            Local definitions            =
+=========================================*/
+
+#define NETPLAY_MAGIC 0x4e534157 // "WASN"
+
+/**
+ * Packet header words: magic, seed, world width, world height, tick length
+ * (the bits of sim_dt), acked ticks, first tick, input count
+ */
+#define NETPLAY_HEADER_WORDS 8
+#define NETPLAY_PACKET_MAX (NETPLAY_HEADER_WORDS * 4 + NETPLAY_RING)
+
+/**
+ * Remote inputs may run ahead of us by up to NETPLAY_RING ticks,
+ * and rollbacks need the NETPLAY_RING ticks behind
+ */
+#define NETPLAY_REMOTE_RING (2 * NETPLAY_RING)
+
+/**
+ * Max packets held back by simulated latency
+ */
+#define NETPLAY_MAX_DELAYED 256
+
+typedef struct {
+    double release_time;
+    int32 size;
+    uint8 data[NETPLAY_PACKET_MAX];
+} DelayedPacket;
+
+static bool running = false;
+static bool started = false;
+static bool is_host;
+static int sock = -1;
+static struct sockaddr_in peer_addr;
+static bool peer_known;
+static uint32 seed;
+
+// Simulation: current_tick is the next tick to simulate
+static uint32 current_tick;
+static uint8 local_inputs[NETPLAY_RING];
+static uint8 predicted_inputs[NETPLAY_RING];
+static uint8 *snapshots[NETPLAY_RING];
+static size_t snapshot_sizes[NETPLAY_RING];
+static size_t snapshot_capacity;
+static bool fire_latched;
+
+// Remote inputs: ticks below remote_confirmed are all known.
+// remote_tags[slot] holds tick + 1 of the input in that slot.
+static uint8 remote_inputs[NETPLAY_REMOTE_RING];
+static uint32 remote_tags[NETPLAY_REMOTE_RING];
+static uint32 remote_confirmed;
+static uint32 remote_acked;
+static uint32 rollback_tick;
+
+// Simulated network conditions
+static double latency = 0.0;
+static int32 loss_percent = 0;
+static DelayedPacket delayed[NETPLAY_MAX_DELAYED];
+static int32 num_delayed = 0;
+static uint32 packets_lost = 0;     // Simulated loss, overflowing the delay queue included
+
+/*=====  End of Local definitions  ======*/
+
+
+
+/**
+ * @brief      Opens the non-blocking UDP socket, bound to port (0 for any)
+ *
+ * @param[in]  port  The port
+ */
+static void netplay_open_socket(int32 port) {
+    struct sockaddr_in addr;
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        error("Couldn't create netplay socket");
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16)port);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        error("Couldn't bind netplay socket");
+    }
+
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+}
+
+/**
+ * @brief      Allocates the snapshot ring and clears input history
+ */
+static void netplay_init_state() {
+    int32 i;
+
+    snapshot_capacity = snapshot_get_capacity();
+    for (i = 0; i < NETPLAY_RING; ++i) {
+        snapshots[i] = (uint8 *) malloc(snapshot_capacity);
+        snapshot_sizes[i] = 0;
+        local_inputs[i] = 0;
+        predicted_inputs[i] = 0;
+    }
+    memset(remote_tags, 0, sizeof(remote_tags));
+
+    current_tick = 0;
+    remote_confirmed = 0;
+    remote_acked = 0;
+    rollback_tick = UINT32_MAX;
+    fire_latched = false;
+    peer_known = false;
+    started = false;
+    running = true;
+}
+
+/**
+ * @brief      Builds the shared starting world out of the host's seed
+ */
+static void netplay_start_world() {
+    game_end();
+    sim_seed(seed);
+    game_start();
+
+    ship->x = world_bounds.width / 3.0f;
+    sim_place(&ship->motion, ship->x, ship->y);
+    ship2 = ship_make_new_default();
+    ship2->x = world_bounds.width * 2.0f / 3.0f;
+    sim_place(&ship2->motion, ship2->x, ship2->y);
+    ship2->color = SHIP2_COLOR;
+
+    update_score_text();
+    started = true;
+}
+
+/**
+ * @brief      Sends a packet, or holds it back to simulate latency and loss
+ *
+ * @param      data  Packet bytes
+ * @param[in]  size  Packet size
+ */
+static void netplay_send_raw(const uint8 *data, int32 size) {
+    if (loss_percent > 0 && rand() % 100 < loss_percent) {
+        ++packets_lost;
+        return;
+    }
+
+    if (latency > 0.0) {
+        DelayedPacket *p;
+
+        // Sending it now would jump the queue, so it's lost instead
+        if (num_delayed == NETPLAY_MAX_DELAYED) {
+            ++packets_lost;
+            return;
+        }
+
+        p = &(delayed[num_delayed++]);
+
+        p->release_time = al_get_time() + latency;
+        p->size = size;
+        memcpy(p->data, data, size);
+        return;
+    }
+
+    sendto(sock, data, size, 0, (struct sockaddr *)&peer_addr, sizeof(peer_addr));
+}
+
+/**
+ * @brief      Sends packets whose simulated latency is over
+ */
+static void netplay_flush_delayed() {
+    double now = al_get_time();
+    int32 i = 0;
+
+    while (i < num_delayed) {
+        if (delayed[i].release_time <= now) {
+            sendto(sock, delayed[i].data, delayed[i].size, 0,
+                   (struct sockaddr *)&peer_addr, sizeof(peer_addr));
+            delayed[i] = delayed[--num_delayed];
+        }
+        else {
+            ++i;
+        }
+    }
+}
+
+static void netplay_put_word(uint8 *p, uint32 v) {
+    v = htonl(v);
+    memcpy(p, &v, 4);
+}
+
+static uint32 netplay_get_word(const uint8 *p) {
+    uint32 v;
+    memcpy(&v, p, 4);
+    return ntohl(v);
+}
+
+/**
+ * @brief      Gets the bits of sim_dt, which both peers must agree on
+ *
+ * @return     The bits
+ */
+static uint32 netplay_get_tick_bits() {
+    uint32 bits;
+
+    memcpy(&bits, &sim_dt, 4);
+    return bits;
+}
+
+/**
+ * @brief      Writes a packet header
+ *
+ * @param      data   Packet bytes
+ * @param[in]  acked  Remote ticks known
+ * @param[in]  first  Tick of the first input
+ * @param[in]  count  Number of inputs
+ */
+static void netplay_put_header(uint8 *data, uint32 acked, uint32 first, uint32 count) {
+    netplay_put_word(data, NETPLAY_MAGIC);
+    netplay_put_word(data + 4, seed);
+    netplay_put_word(data + 8, world_bounds.width);
+    netplay_put_word(data + 12, world_bounds.height);
+    netplay_put_word(data + 16, netplay_get_tick_bits());
+    netplay_put_word(data + 20, acked);
+    netplay_put_word(data + 24, first);
+    netplay_put_word(data + 28, count);
+}
+
+/**
+ * @brief      Sends every local input the peer hasn't acknowledged yet
+ */
+static void netplay_send() {
+    uint8 data[NETPLAY_PACKET_MAX];
+    uint32 first = remote_acked;
+    uint32 count;
+    uint32 i;
+
+    if (!peer_known) {
+        return;
+    }
+
+    // Unacknowledged inputs never exceed the ring, since we stall before that
+    if (current_tick - first > NETPLAY_RING) {
+        first = current_tick - NETPLAY_RING;
+    }
+    count = current_tick - first;
+
+    netplay_put_header(data, remote_confirmed, first, count);
+    for (i = 0; i < count; ++i) {
+        data[NETPLAY_HEADER_WORDS * 4 + i] = local_inputs[(first + i) % NETPLAY_RING];
+    }
+
+    netplay_send_raw(data, NETPLAY_HEADER_WORDS * 4 + count);
+}
+
+/**
+ * @brief      Gets the remote input for a tick, or its prediction
+ *
+ * @param[in]  tick  The tick
+ *
+ * @return     SHIP_INPUT_* bits
+ */
+static uint8 netplay_get_remote_input(uint32 tick) {
+    uint32 slot = tick % NETPLAY_REMOTE_RING;
+
+    if (remote_tags[slot] == tick + 1) {
+        return remote_inputs[slot];
+    }
+
+    // Prediction: the remote player keeps doing the last thing we know of,
+    // except firing, which is a one-off
+    if (remote_confirmed > 0) {
+        return remote_inputs[(remote_confirmed - 1) % NETPLAY_REMOTE_RING] & ~SHIP_INPUT_FIRE;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief      Stores one remote input, scheduling a rollback if it was mispredicted
+ *
+ * @param[in]  tick   The tick
+ * @param[in]  input  The input
+ */
+static void netplay_store_remote_input(uint32 tick, uint8 input) {
+    uint32 slot = tick % NETPLAY_REMOTE_RING;
+
+    // Already known, or outside the window we can use
+    if (tick < remote_confirmed || tick >= remote_confirmed + NETPLAY_RING
+            || remote_tags[slot] == tick + 1) {
+        return;
+    }
+
+    remote_inputs[slot] = input;
+    remote_tags[slot] = tick + 1;
+
+    if (tick < current_tick && predicted_inputs[tick % NETPLAY_RING] != input
+            && tick < rollback_tick) {
+        rollback_tick = tick;
+    }
+
+    while (remote_tags[remote_confirmed % NETPLAY_REMOTE_RING] == remote_confirmed + 1) {
+        ++remote_confirmed;
+    }
+}
+
+/**
+ * @brief      Reads every pending packet
+ */
+static void netplay_receive() {
+    uint8 data[NETPLAY_PACKET_MAX];
+    struct sockaddr_in from;
+    socklen_t from_len;
+    ssize_t size;
+
+    while (true) {
+        uint32 first;
+        uint32 count;
+        uint32 i;
+
+        from_len = sizeof(from);
+        size = recvfrom(sock, data, sizeof(data), 0, (struct sockaddr *)&from, &from_len);
+        if (size < 0) {
+            break;
+        }
+
+        if (size < NETPLAY_HEADER_WORDS * 4 || netplay_get_word(data) != NETPLAY_MAGIC) {
+            continue;
+        }
+
+        // Ticks of different lengths can't stay in lockstep. The host turns
+        // such a guest away with a bare header, on which the guest gives up.
+        if (netplay_get_word(data + 16) != netplay_get_tick_bits()) {
+            if (!is_host) {
+                error("Netplay host runs at a different tick rate");
+            }
+            if (!peer_known) {
+                netplay_put_header(data, 0, 0, 0);
+                sendto(sock, data, NETPLAY_HEADER_WORDS * 4, 0, (struct sockaddr *)&from, from_len);
+            }
+            continue;
+        }
+
+        // The host plays with whoever shows up first
+        if (!peer_known) {
+            peer_addr = from;
+            peer_known = true;
+        }
+        else if (from.sin_addr.s_addr != peer_addr.sin_addr.s_addr
+                 || from.sin_port != peer_addr.sin_port) {
+            continue;
+        }
+
+        // The guest adopts the host's world
+        if (!started && !is_host) {
+            seed = netplay_get_word(data + 4);
+            world_set_bounds((int32)netplay_get_word(data + 8),
+                             (int32)netplay_get_word(data + 12));
+            netplay_start_world();
+        }
+
+        if (netplay_get_word(data + 20) > remote_acked) {
+            remote_acked = netplay_get_word(data + 20);
+        }
+
+        first = netplay_get_word(data + 24);
+        count = netplay_get_word(data + 28);
+        if (count > (uint32)size - NETPLAY_HEADER_WORDS * 4) {
+            continue;
+        }
+        for (i = 0; i < count; ++i) {
+            netplay_store_remote_input(first + i, data[NETPLAY_HEADER_WORDS * 4 + i]);
+        }
+    }
+}
+
+/**
+ * @brief      Snapshots the world and simulates one tick
+ *
+ * @param[in]  tick  The tick
+ */
+static void netplay_simulate(uint32 tick) {
+    uint32 slot = tick % NETPLAY_RING;
+    uint8 remote = netplay_get_remote_input(tick);
+    uint8 input1 = is_host ? local_inputs[slot] : remote;
+    uint8 input2 = is_host ? remote : local_inputs[slot];
+
+    snapshot_sizes[slot] = snapshot_save(snapshots[slot], snapshot_capacity, false);
+    predicted_inputs[slot] = remote;
+
+    if (is_game_over) {
+        return;
+    }
+
+    ship->input = input1 & ~SHIP_INPUT_FIRE;
+    ship2->input = input2 & ~SHIP_INPUT_FIRE;
+    if (input1 & SHIP_INPUT_FIRE) {
+        fire_blast(ship);
+    }
+    if (input2 & SHIP_INPUT_FIRE) {
+        fire_blast(ship2);
+    }
+
+    game_tick();
+}
+
+/**
+ * @brief      Hosts a two-player game, waiting for a guest on port
+ *
+ * @param[in]  port  The port
+ */
+void netplay_host(int32 port) {
+    is_host = true;
+    netplay_open_socket(port);
+    netplay_init_state();
+
+    seed = (uint32)time(NULL);
+    netplay_start_world();
+}
+
+/**
+ * @brief      Joins a two-player game
+ *
+ * @param[in]  address  Host address, as HOST:PORT
+ */
+void netplay_join(const char *address) {
+    struct addrinfo hints;
+    struct addrinfo *res;
+    char host[256];
+    const char *colon = strrchr(address, ':');
+
+    if (!colon || (size_t)(colon - address) >= sizeof(host)) {
+        error("Netplay address should be HOST:PORT");
+    }
+    memcpy(host, address, colon - address);
+    host[colon - address] = 0;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo(host, colon + 1, &hints, &res) != 0 || !res) {
+        error("Couldn't resolve netplay host");
+    }
+
+    is_host = false;
+    netplay_open_socket(0);
+    netplay_init_state();
+
+    memcpy(&peer_addr, res->ai_addr, sizeof(peer_addr));
+    peer_known = true;
+    freeaddrinfo(res);
+}
+
+/**
+ * @brief      Simulates network conditions on outgoing packets
+ *
+ * @param[in]  latency_ms    One-way delay added to every packet
+ * @param[in]  loss_percent  Chance of dropping a packet
+ */
+void netplay_set_conditions(int32 latency_ms, int32 percent) {
+    latency = latency_ms / 1000.0;
+    loss_percent = percent;
+}
+
+/**
+ * @brief      Closes the connection and frees the snapshot ring
+ */
+void netplay_shutdown() {
+    int32 i;
+
+    if (!running) {
+        return;
+    }
+
+    if (packets_lost > 0) {
+        printf("netplay: %u packets lost to simulated conditions\n", packets_lost);
+    }
+
+    close(sock);
+    sock = -1;
+
+    for (i = 0; i < NETPLAY_RING; ++i) {
+        free(snapshots[i]);
+        snapshots[i] = NULL;
+    }
+
+    running = false;
+}
+
+/**
+ * @brief      Checks if a two-player game is running
+ *
+ * @return     true if running; false otherwise
+ */
+bool netplay_is_running() {
+    return running;
+}
+
+/**
+ * @brief      Fires a blast from the local ship on the next tick
+ */
+void netplay_fire() {
+    fire_latched = true;
+}
+
+/**
+ * @brief      Exchanges inputs, rolls back if needed and simulates the next tick
+ *
+ * @return     true if the world changed; false while waiting for the peer
+ */
+bool netplay_update() {
+    uint32 slot = current_tick % NETPLAY_RING;
+    bool rolled_back = false;
+
+    netplay_flush_delayed();
+    netplay_receive();
+
+    // The guest keeps knocking until the host answers with its world,
+    // and the host waits for a guest to show up
+    if (!started || !peer_known) {
+        netplay_send();
+        return false;
+    }
+
+    // Mispredicted remote input: back to the world before that tick,
+    // then simulate forward again with what we know now
+    if (rollback_tick < current_tick) {
+        bool particles = particle_is_enabled();
+        uint32 tick;
+
+        // Ticks shown already made their particles
+        particle_set_enabled(false);
+        snapshot_load(snapshots[rollback_tick % NETPLAY_RING],
+                      snapshot_sizes[rollback_tick % NETPLAY_RING]);
+        for (tick = rollback_tick; tick < current_tick; ++tick) {
+            netplay_simulate(tick);
+        }
+        particle_set_enabled(particles);
+        update_score_text();
+        rolled_back = true;
+    }
+    rollback_tick = UINT32_MAX;
+
+    // Too far ahead of the peer to ever roll back: wait for it
+    if (current_tick >= remote_confirmed + NETPLAY_RING - 1) {
+        netplay_send();
+        return rolled_back;
+    }
+
+    local_inputs[slot] = input_get_controls();
+    if (fire_latched) {
+        local_inputs[slot] |= SHIP_INPUT_FIRE;
+        fire_latched = false;
+    }
+
+    netplay_simulate(current_tick);
+    ++current_tick;
+    update_score_text();
+
+    netplay_send();
+
+    return true;
+}
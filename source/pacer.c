@@ -0,0 +1,240 @@
+/*
+ *
+ * MIT License
+ * 
+ * Copyright (c) 2017 Wilk Maia
+ * wilkmaia [at] gmail [dot] com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ */
+
+
+
+/**
+ * Frame pacer functions
+ *
+ * Replaces the Allegro tick timer with deadlines on CLOCK_MONOTONIC.
+ * The main thread sleeps until shortly before each deadline, since the
+ * scheduler may wake it late, and spins the rest of the way. How late
+ * every wake-up was goes into a histogram, reported on exit.
+ */
+
+#define _GNU_SOURCE
+#define WAS_USING_PACER
+#include "wasteroids.h"
+
+#include <sched.h>
+
+
+/*=========================================
+=            Local definitions            =
+=========================================*/
+
+#define NS_PER_SECOND 1000000000LL
+
+/**
+ * How long before a deadline sleeping stops and spinning starts
+ */
+#define SPIN_MARGIN_NS 1000000LL
+
+/**
+ * Upper bounds, in microseconds, of every histogram bucket but the last
+ */
+static const int64 BUCKET_LIMITS_US[PACER_BUCKETS - 1] = {
+    10, 50, 100, 250, 500, 1000, 2000, 5000
+};
+
+static bool enabled = false;
+static int64 period_ns = 0;
+static int64 deadline_ns = 0;
+static PacerStats stats;
+
+/**
+ * @brief      Reads the monotonic clock
+ *
+ * @return     Time in nanoseconds
+ */
+static int64 pacer_now() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64)ts.tv_sec * NS_PER_SECOND + ts.tv_nsec;
+}
+
+/**
+ * @brief      Sleeps until a point in time on the monotonic clock
+ *
+ * @param[in]  when_ns  The time
+ */
+static void pacer_sleep_until(int64 when_ns) {
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)(when_ns / NS_PER_SECOND);
+    ts.tv_nsec = (long)(when_ns % NS_PER_SECOND);
+
+    // Signals cut sleeps short; spinning makes up for it
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+/**
+ * @brief      Puts a wake-up's lateness into the histogram
+ *
+ * @param[in]  late_ns  Lateness
+ */
+static void pacer_record(int64 late_ns) {
+    int64 late_us = late_ns / 1000;
+    int32 i;
+
+    for (i = 0; i < PACER_BUCKETS - 1 && late_us >= BUCKET_LIMITS_US[i]; ++i) {
+    }
+    ++stats.buckets[i];
+    ++stats.frames;
+
+    if (late_ns > stats.max_late_ns) {
+        stats.max_late_ns = late_ns;
+    }
+}
+
+/*=====  End of Local definitions  ======*/
+
+
+/**
+ * @brief      Starts pacing, and pins the calling thread if asked to
+ *
+ * @param[in]  period  Seconds between deadlines
+ * @param[in]  core    Core to pin to, or below 0 to leave it to the scheduler
+ */
+void pacer_init(double period, int32 core) {
+    period_ns = (int64)(period * NS_PER_SECOND + 0.5);
+    deadline_ns = pacer_now() + period_ns;
+    memset(&stats, 0, sizeof(stats));
+    enabled = true;
+
+    if (core < 0) {
+        return;
+    }
+
+#ifdef __linux__
+    {
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        CPU_SET(core, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            fprintf(stderr, "Failed to pin the main thread to core %d: %s\n",
+                    core, strerror(errno));
+        }
+    }
+#else
+    fprintf(stderr, "Pinning to a core isn't supported on this platform\n");
+#endif // __linux__
+}
+
+/**
+ * @brief      Checks if the pacer drives the ticks
+ *
+ * @return     true if so; false otherwise
+ */
+bool pacer_is_enabled() {
+    return enabled;
+}
+
+/**
+ * @brief      Waits for the next deadline
+ */
+void pacer_wait() {
+    int64 now = pacer_now();
+
+    if (now < deadline_ns - SPIN_MARGIN_NS) {
+        pacer_sleep_until(deadline_ns - SPIN_MARGIN_NS);
+    }
+    do {
+        now = pacer_now();
+    } while (now < deadline_ns);
+
+    pacer_record(now - deadline_ns);
+
+    // Deadlines stay on a fixed grid; whole periods overslept are skipped
+    // instead of being run back to back
+    deadline_ns += period_ns;
+    if (now >= deadline_ns) {
+        int64 missed = (now - deadline_ns) / period_ns + 1;
+
+        stats.skipped += (uint64)missed;
+        deadline_ns += missed * period_ns;
+    }
+}
+
+/**
+ * @brief      Starts the deadlines over from now, after the loop stood still
+ */
+void pacer_resync() {
+    deadline_ns = pacer_now() + period_ns;
+}
+
+/**
+ * @brief      Gets what the pacer measured so far
+ *
+ * @return     The stats
+ */
+const PacerStats * pacer_get_stats() {
+    return &stats;
+}
+
+/**
+ * @brief      Gets the upper bound of a histogram bucket
+ *
+ * @param[in]  bucket  The bucket
+ *
+ * @return     Bound in microseconds, or -1 for the last, unbounded, bucket
+ */
+int64 pacer_get_bucket_limit_us(int32 bucket) {
+    return (bucket < PACER_BUCKETS - 1) ? BUCKET_LIMITS_US[bucket] : -1;
+}
+
+/**
+ * @brief      Prints the lateness histogram
+ */
+void pacer_report() {
+    int64 low = 0;
+    int32 i;
+
+    if (!enabled || stats.frames == 0) {
+        return;
+    }
+
+    printf("Pacer over %llu frames: max late %.1f us, %llu deadlines skipped\n",
+           (unsigned long long)stats.frames, stats.max_late_ns / 1000.0,
+           (unsigned long long)stats.skipped);
+
+    for (i = 0; i < PACER_BUCKETS; ++i) {
+        int64 high = pacer_get_bucket_limit_us(i);
+
+        if (high >= 0) {
+            printf("  %5lld-%5lld us: %llu\n", (long long)low, (long long)high,
+                   (unsigned long long)stats.buckets[i]);
+            low = high;
+        }
+        else {
+            printf("  %5lld+      us: %llu\n", (long long)low,
+                   (unsigned long long)stats.buckets[i]);
+        }
+    }
+}
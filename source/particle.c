@@ -0,0 +1,333 @@
+/*
+ *
+ * MIT License
+ * 
+ * Copyright (c) 2017 Wilk Maia
+ * wilkmaia [at] gmail [dot] com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ */
+
+
+/**
+ * Particle functions
+ *
+ * Cosmetic debris and thrust particles. They live in a fixed-size ring
+ * stored as one array per field, so the update is a plain loop over floats
+ * the compiler can vectorise, and they are drawn with a single primitive
+ * call. When the ring is full, new particles replace the oldest ones; no
+ * memory is ever allocated. Only the span of the ring from the oldest live
+ * particle up to the newest one is updated and drawn, so an empty ring
+ * costs nothing.
+ *
+ * Particles don't take part in the simulation and draw from their own
+ * random numbers, so they never affect determinism.
+ */
+
+#define WAS_USING_SHIP
+#define WAS_USING_PARTICLE
+#include "wasteroids.h"
+
+#include <allegro5/allegro_primitives.h>
+
+
+/*=========================================
+=            Local definitions            =
+=========================================*/
+
+/**
+ * Velocity kept over 1/60 s
+ */
+static const float DRAG = 0.96f;
+
+/**
+ * Streaks show where a particle was this long ago, in seconds
+ */
+static const float STREAK_TIME = 1.0f / 60.0f;
+
+typedef enum {
+    PARTICLE_DEBRIS,
+    PARTICLE_THRUST,
+    PARTICLE_NUM_KINDS
+} ParticleKind;
+
+static const float PALETTE[PARTICLE_NUM_KINDS][3] = {
+    { 0.5f, 0.6f, 1.0f },   // debris
+    { 1.0f, 0.6f, 0.0f }    // thrust
+};
+
+static bool enabled = false;
+static int32 draw_limit = PARTICLE_MAX;
+static int32 head = 0;
+static int32 span = 0;      // Slots right before head that may be alive
+static uint32 random_state = 1;
+
+static float px[PARTICLE_MAX];
+static float py[PARTICLE_MAX];
+static float pvx[PARTICLE_MAX];
+static float pvy[PARTICLE_MAX];
+static float plife[PARTICLE_MAX];
+static float pmax_life[PARTICLE_MAX];
+static uint8 pkind[PARTICLE_MAX];
+
+static ALLEGRO_VERTEX vertices[2 * PARTICLE_MAX];
+
+/*=====  End of Local definitions  ======*/
+
+
+
+/**
+ * @brief      Draws a cosmetic random number in [0, 1)
+ *
+ * @return     The number
+ */
+static float particle_random() {
+    random_state = random_state * 1664525u + 1013904223u;
+    return (random_state >> 8) / 16777216.0f;
+}
+
+/**
+ * @brief      Writes a particle over the oldest slot of the ring
+ */
+static void particle_emit(float x, float y, float vx, float vy, float life, ParticleKind kind) {
+    px[head] = x;
+    py[head] = y;
+    pvx[head] = vx;
+    pvy[head] = vy;
+    plife[head] = life;
+    pmax_life[head] = life;
+    pkind[head] = (uint8)kind;
+
+    head = (head + 1) % PARTICLE_MAX;
+    if (span < PARTICLE_MAX) {
+        ++span;
+    }
+}
+
+/**
+ * @brief      Gets the oldest slot of the live span
+ *
+ * @return     Index on the ring
+ */
+static int32 particle_get_tail() {
+    return (head - span + PARTICLE_MAX) % PARTICLE_MAX;
+}
+
+/**
+ * @brief      Moves particles [first, last) forward in time
+ *
+ * @param[in]  first    First slot
+ * @param[in]  last     One past the last slot
+ * @param[in]  seconds  Time step
+ * @param[in]  drag     Velocity kept over the step
+ */
+static void particle_advance(int32 first, int32 last, float seconds, float drag) {
+    int32 i;
+
+    // Branch free, so it vectorises. Lives stop at 0 so dead slots settle.
+    for (i = first; i < last; ++i) {
+        px[i] += pvx[i] * seconds;
+        py[i] += pvy[i] * seconds;
+        pvx[i] *= drag;
+        pvy[i] *= drag;
+        plife[i] = fmaxf(plife[i] - seconds, 0.0f);
+    }
+}
+
+/**
+ * @brief      Turns particles on or off. Headless games leave them off.
+ *
+ * @param[in]  on    true to enable
+ */
+void particle_set_enabled(bool on) {
+    enabled = on;
+}
+
+/**
+ * @brief      Checks if particles are enabled
+ *
+ * @return     true if enabled; false otherwise
+ */
+bool particle_is_enabled() {
+    return enabled;
+}
+
+/**
+ * @brief      Kills every particle. Headless games, which share the ring
+ *             across threads but never enable it, leave it alone.
+ */
+void particle_clear() {
+    int32 i;
+
+    if (!enabled) {
+        return;
+    }
+
+    for (i = 0; i < PARTICLE_MAX; ++i) {
+        plife[i] = 0.0f;
+    }
+    head = 0;
+    span = 0;
+}
+
+/**
+ * @brief      Bursts debris out of a destroyed or split asteroid
+ *
+ * @param[in]  x      Center x-coord
+ * @param[in]  y      Center y-coord
+ * @param[in]  scale  Asteroid scale, bigger asteroids make more debris
+ */
+void particle_emit_debris(float x, float y, float scale) {
+    int32 count;
+    int32 i;
+
+    if (!enabled) {
+        return;
+    }
+
+    count = (int32)(24.0f * scale);
+    for (i = 0; i < count; ++i) {
+        float angle = MAX_ANGLE * particle_random();
+        float speed = 30.0f + 180.0f * particle_random();
+
+        particle_emit(x, y, speed * cosf(angle), -speed * sinf(angle),
+                      (20.0f + 40.0f * particle_random()) / 60.0f, PARTICLE_DEBRIS);
+    }
+}
+
+/**
+ * @brief      Puffs exhaust out of the back of a thrusting ship
+ *
+ * @param      s     The ship
+ */
+void particle_emit_thrust(Ship *s) {
+    float back_x;
+    float back_y;
+    int32 i;
+
+    if (!enabled) {
+        return;
+    }
+
+    back_x = s->x - s->scale * 9.0f * cosf(s->direction);
+    back_y = s->y + s->scale * 9.0f * sinf(s->direction);
+
+    for (i = 0; i < 2; ++i) {
+        float angle = s->direction + (float)ALLEGRO_PI + 0.6f * (particle_random() - 0.5f);
+        float speed = 120.0f + 120.0f * particle_random();
+
+        particle_emit(back_x, back_y, speed * cosf(angle), -speed * sinf(angle),
+                      (10.0f + 10.0f * particle_random()) / 60.0f, PARTICLE_THRUST);
+    }
+}
+
+/**
+ * @brief      Moves every particle forward in time
+ *
+ * @param[in]  seconds  Time step
+ */
+void particle_update(float seconds) {
+    float drag;
+    int32 tail;
+
+    if (!enabled || span == 0) {
+        return;
+    }
+
+    drag = powf(DRAG, seconds * 60.0f);
+
+    // The span may wrap around the end of the ring
+    tail = particle_get_tail();
+    if (tail + span <= PARTICLE_MAX) {
+        particle_advance(tail, tail + span, seconds, drag);
+    }
+    else {
+        particle_advance(tail, PARTICLE_MAX, seconds, drag);
+        particle_advance(0, head, seconds, drag);
+    }
+
+    // Lifetimes are short, so particles that died out of order soon reach the tail
+    while (span > 0 && plife[particle_get_tail()] <= 0.0f) {
+        --span;
+    }
+}
+
+/**
+ * @brief      Caps how many particles get drawn per frame
+ *
+ * @param[in]  n     Max particles drawn
+ */
+void particle_set_draw_limit(int32 n) {
+    draw_limit = n;
+}
+
+/**
+ * @brief      Draws live particles as short streaks, in one batch
+ */
+void particle_draw_all() {
+    int32 n = 0;
+    int32 tail;
+    int32 k;
+
+    if (!enabled) {
+        return;
+    }
+
+    tail = particle_get_tail();
+    for (k = 0; k < span && n < 2 * draw_limit; ++k) {
+        int32 i = (tail + k) % PARTICLE_MAX;
+        const float *rgb;
+        float alpha;
+        ALLEGRO_COLOR color;
+
+        if (plife[i] <= 0.0f) {
+            continue;
+        }
+
+        // Fades out with age (colors are premultiplied)
+        rgb = PALETTE[pkind[i]];
+        alpha = plife[i] / pmax_life[i];
+        color = al_map_rgba_f(rgb[0] * alpha, rgb[1] * alpha, rgb[2] * alpha, alpha);
+
+        vertices[n].x = px[i];
+        vertices[n].y = py[i];
+        vertices[n].z = 0.0f;
+        vertices[n].color = color;
+        vertices[n + 1].x = px[i] - pvx[i] * STREAK_TIME;
+        vertices[n + 1].y = py[i] - pvy[i] * STREAK_TIME;
+        vertices[n + 1].z = 0.0f;
+        vertices[n + 1].color = color;
+        n += 2;
+    }
+
+    if (n > 0) {
+        al_draw_prim(vertices, NULL, NULL, 0, n, ALLEGRO_PRIM_LINE_LIST);
+    }
+}
+
+/**
+ * @brief      Checks if any particle is still alive
+ *
+ * @return     true if so; false otherwise
+ */
+bool particle_any_alive() {
+    // Emits add live particles and updates trim dead ones off the span
+    return enabled && span > 0;
+}
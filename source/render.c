@@ -0,0 +1,204 @@
+/*
+ *
+ * MIT License
+ * 
+ * Copyright (c) 2017 Wilk Maia
+ * wilkmaia [at] gmail [dot] com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ */
+
+
+
+/**
+ * Render scaling functions
+ *
+ * Draws the scene into an offscreen bitmap at a fraction of the display's
+ * resolution, then upscales it to the backbuffer in one blit. Everything
+ * is drawn through a scale transform, so simulation coordinates don't
+ * change with the render resolution. At full scale the backbuffer is
+ * drawn to directly and keeps its multisampling. The display's size is
+ * cached, and only changes through render_resize.
+ */
+
+#define WAS_USING_RENDER
+#include "wasteroids.h"
+
+
+/*=========================================
+=            Local definitions            =
+=========================================*/
+
+static ALLEGRO_BITMAP *target = NULL;
+static float base_scale = 1.0f;
+static float scale = 1.0f;
+static bool drawing_offscreen = false;
+static int32 display_width = 0;
+static int32 display_height = 0;
+
+/**
+ * @brief      Gets how many pixels a display length takes at a scale
+ *
+ * @param[in]  length  Display length
+ * @param[in]  s       The scale
+ *
+ * @return     Pixels, at least one
+ */
+static int32 render_scaled(int32 length, float s) {
+    int32 n = (int32)ceilf(length * s);
+
+    return (n > 0) ? n : 1;
+}
+
+/**
+ * @brief      Creates the offscreen bitmap, big enough for the base scale.
+ *             Lower scales draw into its top left corner.
+ *
+ * @return     true if there's a bitmap; false otherwise
+ */
+static bool render_create_target() {
+    int32 flags = al_get_new_bitmap_flags();
+
+    if (target) {
+        return true;
+    }
+
+    al_set_new_bitmap_flags(ALLEGRO_VIDEO_BITMAP | ALLEGRO_MIN_LINEAR | ALLEGRO_MAG_LINEAR);
+    target = al_create_bitmap(render_scaled(display_width, base_scale),
+                              render_scaled(display_height, base_scale));
+    al_set_new_bitmap_flags(flags);
+
+    if (!target) {
+        fprintf(stderr, "Failed to create the render target, drawing at full resolution\n");
+        return false;
+    }
+
+    return true;
+}
+
+/*=====  End of Local definitions  ======*/
+
+
+
+/**
+ * @brief      Sets the render scale the game starts at, and never goes above
+ *
+ * @param[in]  s     Fraction of the display's resolution
+ */
+void render_init(float s) {
+    display_width = al_get_display_width(screen);
+    display_height = al_get_display_height(screen);
+    base_scale = (s < RENDER_SCALE_MIN) ? RENDER_SCALE_MIN : (s > 1.0f ? 1.0f : s);
+    render_set_scale(base_scale);
+}
+
+/**
+ * @brief      Frees the offscreen bitmap
+ */
+void render_shutdown() {
+    if (target) {
+        al_destroy_bitmap(target);
+        target = NULL;
+    }
+}
+
+/**
+ * @brief      Follows a change of the display's size
+ *
+ * @param[in]  width   New display width
+ * @param[in]  height  New display height
+ */
+void render_resize(int32 width, int32 height) {
+    display_width = width;
+    display_height = height;
+
+    // The bitmap is sized for the display, so it is made over at the new size
+    render_shutdown();
+    render_set_scale(scale);
+}
+
+/**
+ * @brief      Gets the scale render_init was given
+ *
+ * @return     The scale
+ */
+float render_get_base_scale() {
+    return base_scale;
+}
+
+/**
+ * @brief      Gets the current render scale
+ *
+ * @return     The scale
+ */
+float render_get_scale() {
+    return scale;
+}
+
+/**
+ * @brief      Changes the render scale, between frames
+ *
+ * @param[in]  s     Fraction of the display's resolution, clamped to the base scale
+ */
+void render_set_scale(float s) {
+    s = (s < RENDER_SCALE_MIN) ? RENDER_SCALE_MIN : (s > base_scale ? base_scale : s);
+
+    // No bitmap, no scaling
+    if (s < 1.0f && !render_create_target()) {
+        s = 1.0f;
+    }
+
+    scale = s;
+}
+
+/**
+ * @brief      Makes the following drawing go to the scaled render target
+ */
+void render_begin() {
+    ALLEGRO_TRANSFORM transform;
+
+    drawing_offscreen = scale < 1.0f;
+    if (!drawing_offscreen) {
+        return;
+    }
+
+    al_set_target_bitmap(target);
+    al_set_clipping_rectangle(0, 0, render_scaled(display_width, scale),
+                              render_scaled(display_height, scale));
+
+    al_identity_transform(&transform);
+    al_scale_transform(&transform, scale, scale);
+    al_use_transform(&transform);
+}
+
+/**
+ * @brief      Upscales what was drawn since render_begin to the backbuffer
+ */
+void render_end() {
+    if (!drawing_offscreen) {
+        return;
+    }
+
+    al_set_target_backbuffer(screen);
+    al_draw_scaled_bitmap(target, 0, 0, render_scaled(display_width, scale),
+                          render_scaled(display_height, scale),
+                          0, 0, display_width, display_height, 0);
+    drawing_offscreen = false;
+}
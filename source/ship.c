@@ -34,6 +34,7 @@
  */
 
 #define WAS_USING_SHIP
+#define WAS_USING_PARTICLE
 #include "wasteroids.h"
 
 
@@ -79,10 +80,14 @@ Ship * ship_make_new(float x, float y, float direction, float scale, float speed
     newShip->direction = direction;
     newShip->scale = scale;
     newShip->speed = speed;
+    sim_place(&newShip->motion, x, y);
     newShip->alive = alive;
     newShip->color = color;
     newShip->thickness = thickness;
     newShip->lives = SHIP_LIVES;
+    newShip->can_be_hit = true;
+    newShip->can_be_hit_count = 0;
+    newShip->input = 0;
 
     return newShip;
 }
@@ -94,11 +99,11 @@ Ship * ship_make_new(float x, float y, float direction, float scale, float speed
  */
 Ship * ship_make_new_default() {
     Ship * newShip;
-    float x = al_get_display_width(screen) / 2.0f;
-    float y = al_get_display_height(screen) / 2.0f;
+    float x = world_bounds.width / 2.0f;
+    float y = world_bounds.height / 2.0f;
     float direction = (float)ALLEGRO_PI / 2.0f;
     float scale = 2.0f;
-    float speed = 3.0f;
+    float speed = 180.0f;
     bool alive = true;
     ALLEGRO_COLOR color = SHIP_COLOR;
     float thickness = 3.0f;
@@ -133,22 +138,25 @@ int8 ship_draw(Ship *ship) {
     al_scale_transform(&transform, ship->scale, ship->scale);
     al_rotate_transform(&transform, -ship->direction + (float)ALLEGRO_PI / 2.0f);
     al_translate_transform(&transform, ship->x, ship->y);
+    if (prevTransform != NULL) {
+        al_compose_transform(&transform, prevTransform);
+    }
     al_use_transform(&transform);
     
     // Draws ship
     if (!ship->can_be_hit) {
-        if (!((ship->can_be_hit_count / 7) % 2)) {
-            al_draw_line(-8, 9, 0, -11, al_map_rgb(255, 255, 0), ship->thickness);
-            al_draw_line(0, -11, 8, 9, al_map_rgb(255, 255, 0), ship->thickness);
-            al_draw_line(-6, 4, -1, 4, al_map_rgb(255, 255, 0), ship->thickness);
-            al_draw_line(6, 4, 1, 4, al_map_rgb(255, 255, 0), ship->thickness);
+        if (!((int32)(ship->can_be_hit_count * sim_dt / SHIP_BLINK_PERIOD) % 2)) {
+            al_draw_line(-8, 9, 0, -11, al_map_rgb(255, 255, 0), RENDER_THICKNESS(ship->thickness));
+            al_draw_line(0, -11, 8, 9, al_map_rgb(255, 255, 0), RENDER_THICKNESS(ship->thickness));
+            al_draw_line(-6, 4, -1, 4, al_map_rgb(255, 255, 0), RENDER_THICKNESS(ship->thickness));
+            al_draw_line(6, 4, 1, 4, al_map_rgb(255, 255, 0), RENDER_THICKNESS(ship->thickness));
         }
     }
     else {
-        al_draw_line(-8, 9, 0, -11, ship->color, ship->thickness);
-        al_draw_line(0, -11, 8, 9, ship->color, ship->thickness);
-        al_draw_line(-6, 4, -1, 4, ship->color, ship->thickness);
-        al_draw_line(6, 4, 1, 4, ship->color, ship->thickness);
+        al_draw_line(-8, 9, 0, -11, ship->color, RENDER_THICKNESS(ship->thickness));
+        al_draw_line(0, -11, 8, 9, ship->color, RENDER_THICKNESS(ship->thickness));
+        al_draw_line(-6, 4, -1, 4, ship->color, RENDER_THICKNESS(ship->thickness));
+        al_draw_line(6, 4, 1, 4, ship->color, RENDER_THICKNESS(ship->thickness));
     }
 
     // Reloads previous transform state
@@ -181,47 +189,49 @@ void ship_get_base_points(Ship *ship, float *x, float *y) {
     scale = ship->scale;
 
     // If it crosses the border, make it apper on the other side
-    width = al_get_display_width(screen);
-    height = al_get_display_height(screen);
+    width = world_bounds.width;
+    height = world_bounds.height;
     if (x_center > width) {
         x_center = 0;
-        ship->x = 0;
     }
     else if (x_center < 0) {
         x_center = width;
-        ship->x = width;
     }
 
     if (y_center > height) {
         y_center = 0;
-        ship->y = 0;
     }
     else if (y_center < 0) {
         y_center = height;
-        ship->y = height;
+    }
+
+    if (ship->x != x_center || ship->y != y_center) {
+        ship->x = x_center;
+        ship->y = y_center;
+        sim_place(&ship->motion, ship->x, ship->y);
     }
 
     // Get base points
     x[0] = x_center;
     y[0] = y_center;
 
-    x[1] = x_center + scale * SHIP_DIMENSION * (float) cos(dir + alpha1);
-    y[1] = y_center - scale * SHIP_DIMENSION * (float) sin(dir + alpha1);
+    x[1] = x_center + scale * SHIP_DIMENSION * sim_cos(dir + alpha1);
+    y[1] = y_center - scale * SHIP_DIMENSION * sim_sin(dir + alpha1);
 
-    x[3] = x_center + scale * SHIP_DIMENSION * (float) cos(dir + alpha3) * 2.0f / 3.0f;
-    y[3] = y_center - scale * SHIP_DIMENSION * (float) sin(dir + alpha3) * 2.0f / 3.0f;
+    x[3] = x_center + scale * SHIP_DIMENSION * sim_cos(dir + alpha3) * 2.0f / 3.0f;
+    y[3] = y_center - scale * SHIP_DIMENSION * sim_sin(dir + alpha3) * 2.0f / 3.0f;
 
-    x[4] = x_center + scale * SHIP_DIMENSION * (float) cos(dir + alpha4) * 2.0f / 3.0f;
-    y[4] = y_center - scale * SHIP_DIMENSION * (float) sin(dir + alpha4) * 2.0f / 3.0f;
+    x[4] = x_center + scale * SHIP_DIMENSION * sim_cos(dir + alpha4) * 2.0f / 3.0f;
+    y[4] = y_center - scale * SHIP_DIMENSION * sim_sin(dir + alpha4) * 2.0f / 3.0f;
 
-    x[2] = x_center + scale * SHIP_DIMENSION * (float) cos(dir - alpha1);
-    y[2] = y_center - scale * SHIP_DIMENSION * (float) sin(dir - alpha1);
+    x[2] = x_center + scale * SHIP_DIMENSION * sim_cos(dir - alpha1);
+    y[2] = y_center - scale * SHIP_DIMENSION * sim_sin(dir - alpha1);
 
-    x[6] = x_center + scale * SHIP_DIMENSION * (float) cos(dir - alpha3) * 2.0f / 3.0f;
-    y[6] = y_center - scale * SHIP_DIMENSION * (float) sin(dir - alpha3) * 2.0f / 3.0f;
+    x[6] = x_center + scale * SHIP_DIMENSION * sim_cos(dir - alpha3) * 2.0f / 3.0f;
+    y[6] = y_center - scale * SHIP_DIMENSION * sim_sin(dir - alpha3) * 2.0f / 3.0f;
 
-    x[5] = x_center + scale * SHIP_DIMENSION * (float) cos(dir - alpha4) * 2.0f / 3.0f;
-    y[5] = y_center - scale * SHIP_DIMENSION * (float) sin(dir - alpha4) * 2.0f / 3.0f;
+    x[5] = x_center + scale * SHIP_DIMENSION * sim_cos(dir - alpha4) * 2.0f / 3.0f;
+    y[5] = y_center - scale * SHIP_DIMENSION * sim_sin(dir - alpha4) * 2.0f / 3.0f;
 }
 
 /**
@@ -239,38 +249,55 @@ Ship * ship_delete(Ship *ship) {
 }
 
 /**
- * @brief      Moves the ship
+ * @brief      Moves the ship according to its held controls (ship->input)
  *
  * @param      ship  The ship
  */
 void ship_move(Ship *ship) {
-    float dx;
-    float dy;
-
-    dx = 0.0f;
-    dy = 0.0f;
-
-    if (pressed_keys[ALLEGRO_KEY_UP]) {
-        dx = ship->speed * (float)cos(ship->direction);
-        dy = - ship->speed * (float)sin(ship->direction);
+    if (ship->input & SHIP_INPUT_THRUST) {
+        sim_advance(&ship->motion, &ship->x, &ship->y, ship->speed * sim_dt, ship->direction);
+        particle_emit_thrust(ship);
     }
     
-    if (pressed_keys[ALLEGRO_KEY_LEFT]) {
-        ship->direction += DIRECTION_STEP;
+    if (ship->input & SHIP_INPUT_LEFT) {
+        ship->direction += SHIP_TURN_RATE * sim_dt;
         if (ship->direction >= MAX_ANGLE) {
             ship->direction = 0.0f + (ship->direction - MAX_ANGLE);
         }
     }
 
-    if (pressed_keys[ALLEGRO_KEY_RIGHT]) {
-        ship->direction -= DIRECTION_STEP;
+    if (ship->input & SHIP_INPUT_RIGHT) {
+        ship->direction -= SHIP_TURN_RATE * sim_dt;
         if (ship->direction < 0.0f) {
             ship->direction = MAX_ANGLE + ship->direction;
         }
     }
+}
+
+/**
+ * @brief      Gets the direction to draw the ship with, turned ahead by the
+ *             part of the next tick's turn that already elapsed, so held
+ *             keys show on screen before the tick that applies them
+ *
+ * @param      ship      The ship
+ * @param[in]  controls  SHIP_INPUT_* bits held right now
+ * @param[in]  fraction  Part of the tick period elapsed since the last tick
+ *
+ * @return     Direction to draw with
+ */
+float ship_get_late_direction(Ship *ship, uint8 controls, float fraction) {
+    float direction = ship->direction;
+
+    fraction = (fraction < 0.0f) ? 0.0f : (fraction > 1.0f ? 1.0f : fraction);
+
+    if (controls & SHIP_INPUT_LEFT) {
+        direction += SHIP_TURN_RATE * sim_dt * fraction;
+    }
+    if (controls & SHIP_INPUT_RIGHT) {
+        direction -= SHIP_TURN_RATE * sim_dt * fraction;
+    }
 
-    ship->x += dx;
-    ship->y += dy;
+    return direction;
 }
 
 /**
@@ -285,8 +312,9 @@ int8 ship_hit(Ship *ship) {
     ship->alive = true;
     ship->can_be_hit = false;
     ship->can_be_hit_count = 0;
-    ship->x = al_get_display_width(screen) / 2.0f;
-    ship->y = al_get_display_height(screen) / 2.0f;
+    ship->x = world_bounds.width / 2.0f;
+    ship->y = world_bounds.height / 2.0f;
+    sim_place(&ship->motion, ship->x, ship->y);
     ship->direction = (float)ALLEGRO_PI / 2.0f;
 
     return ship->lives;
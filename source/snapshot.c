@@ -0,0 +1,884 @@
+/*
+ *
+ * MIT License
+ * 
+ * Copyright (c) 2017 Wilk Maia
+ * wilkmaia [at] gmail [dot] com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ */
+
+
+/**
+ * Snapshot functions
+ *
+ * Saves and loads the whole game state in a versioned binary format:
+ *
+ *   header    SnapshotHeader, with the world bounds, never compressed
+ *   payload   SnapshotWorld, SnapshotShip (two in two-player games),
+ *             num_blasts SnapshotBlast records and num_asteroids
+ *             SnapshotAsteroid records, optionally compressed in the
+ *             LZ4 block format
+ *
+ * Every field is a little-endian 32-bit word, so on little-endian hosts
+ * records are plain memcpy's of these structs. Fixed-point builds save
+ * positions the way they simulate them, on 16.16 fixed-point, so a rollback
+ * restores them bit for bit; those snapshots only load on such builds.
+ */
+
+#define WAS_USING_SHIP
+#define WAS_USING_BLAST
+#define WAS_USING_ASTEROID
+#define WAS_USING_SNAPSHOT
+#define WAS_USING_IO
+#define WAS_USING_FIXED
+#include "wasteroids.h"
+
+
+/*=========================================
+=            Local definitions            =
+=========================================*/
+
+#define SNAPSHOT_MAGIC 0x54534157 // "WAST"
+
+typedef struct {
+    uint32 magic;
+    uint32 version;
+    uint32 flags;
+    uint32 raw_size;
+    uint32 stored_size;
+    uint32 world_width;     // World bounds it was saved in, restored on load
+    uint32 world_height;
+} SnapshotHeader;
+
+typedef struct {
+    uint32 score_count;
+    uint32 is_game_over;
+    uint32 sim_rng_seed;
+    uint32 sim_tick;
+    uint32 num_ships;
+    uint32 num_blasts;
+    uint32 num_asteroids;
+} SnapshotWorld;
+
+/**
+ * Float bits, or 16.16 fixed-point with SNAPSHOT_FIXED_POINT
+ */
+typedef struct {
+    uint32 x;
+    uint32 y;
+} SnapshotPos;
+
+typedef struct {
+    SnapshotPos pos;
+    float direction;
+    float scale;
+    float speed;
+    int32 lives;
+    int32 can_be_hit;
+    int32 can_be_hit_count;
+} SnapshotShip;
+
+typedef struct {
+    SnapshotPos pos;
+    float direction;
+    float size;
+    float speed;
+} SnapshotBlast;
+
+typedef struct {
+    SnapshotPos pos;
+    float direction;
+    float scale;
+    float speed;
+    int32 shape;
+    uint32 id;
+} SnapshotAsteroid;
+
+#ifdef WAS_FIXED_POINT
+    #define SNAPSHOT_BUILD_FLAGS SNAPSHOT_FIXED_POINT
+#else
+    #define SNAPSHOT_BUILD_FLAGS 0
+#endif // WAS_FIXED_POINT
+
+/**
+ * Worst case size of n bytes compressed in the LZ4 block format
+ */
+#define LZ_BOUND(n) ((n) + (n) / 255 + 16)
+
+/**
+ * Largest uncompressed payload: two ships and full blast and asteroid lists
+ */
+#define SNAPSHOT_RAW_MAX (sizeof(SnapshotWorld) + 2 * sizeof(SnapshotShip) \
+                          + BLAST_MAX * sizeof(SnapshotBlast) \
+                          + ASTEROID_MAX * sizeof(SnapshotAsteroid))
+
+/**
+ * How far past the world edge a saved position may lie. Entities can sit
+ * just outside for a tick before they wrap around or go away.
+ */
+#define SNAPSHOT_EDGE_SLACK 64.0f
+
+/**
+ * Largest world side a snapshot may have
+ */
+#define SNAPSHOT_WORLD_MAX 0xffff
+
+/**
+ * LZ4 format limits: no match may start in the last 12 bytes,
+ * and the last 5 bytes are always literals
+ */
+#define LZ_MIN_MATCH 4
+#define LZ_MATCH_LIMIT 12
+#define LZ_LAST_LITERALS 5
+#define LZ_HASH_BITS 12
+#define LZ_MAX_OFFSET 65535
+
+/*=====  End of Local definitions  ======*/
+
+
+
+/**
+ * @brief      Converts 32-bit words between host and snapshot (little-endian) order
+ *
+ * @param      data     The words
+ * @param[in]  n_bytes  Size in bytes, multiple of 4
+ */
+static void snapshot_swap_words(void *data, size_t n_bytes) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    uint32 *words = (uint32 *)data;
+    size_t i;
+
+    for (i = 0; i < n_bytes / 4; ++i) {
+        words[i] = __builtin_bswap32(words[i]);
+    }
+#else
+    (void)data;
+    (void)n_bytes;
+#endif // __BYTE_ORDER__
+}
+
+static uint32 lz_read32(const uint8 *p) {
+    uint32 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint8 * lz_write_length(uint8 *op, size_t length) {
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (uint8)length;
+
+    return op;
+}
+
+/**
+ * @brief      Compresses src into dst in the LZ4 block format (greedy, single pass)
+ *
+ * @param      src   Source bytes
+ * @param[in]  n     Number of source bytes
+ * @param      dst   Destination, at least LZ_BOUND(n) bytes
+ *
+ * @return     Number of compressed bytes
+ */
+static size_t lz_compress(const uint8 *src, size_t n, uint8 *dst) {
+    uint32 table[1 << LZ_HASH_BITS] = {0};
+    size_t ip = 0;
+    size_t anchor = 0;
+    size_t literals;
+    uint8 *op = dst;
+    uint8 *token;
+
+    while (n > LZ_MATCH_LIMIT && ip < n - LZ_MATCH_LIMIT) {
+        uint32 seq = lz_read32(src + ip);
+        uint32 h = (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+        size_t ref = table[h];
+        size_t match;
+
+        table[h] = (uint32)ip;
+        if (ref >= ip || ip - ref > LZ_MAX_OFFSET || lz_read32(src + ref) != seq) {
+            ++ip;
+            continue;
+        }
+
+        match = LZ_MIN_MATCH;
+        while (ip + match < n - LZ_LAST_LITERALS && src[ref + match] == src[ip + match]) {
+            ++match;
+        }
+
+        // Literals since last match
+        literals = ip - anchor;
+        token = op++;
+        *token = (uint8)((literals >= 15 ? 15 : literals) << 4);
+        if (literals >= 15) {
+            op = lz_write_length(op, literals - 15);
+        }
+        memcpy(op, src + anchor, literals);
+        op += literals;
+
+        // Match
+        *op++ = (uint8)((ip - ref) & 0xff);
+        *op++ = (uint8)((ip - ref) >> 8);
+        *token |= (uint8)(match - LZ_MIN_MATCH >= 15 ? 15 : match - LZ_MIN_MATCH);
+        if (match - LZ_MIN_MATCH >= 15) {
+            op = lz_write_length(op, match - LZ_MIN_MATCH - 15);
+        }
+
+        ip += match;
+        anchor = ip;
+    }
+
+    // Last literals
+    literals = n - anchor;
+    token = op++;
+    *token = (uint8)((literals >= 15 ? 15 : literals) << 4);
+    if (literals >= 15) {
+        op = lz_write_length(op, literals - 15);
+    }
+    memcpy(op, src + anchor, literals);
+    op += literals;
+
+    return (size_t)(op - dst);
+}
+
+/**
+ * @brief      Decompresses an LZ4 block, checking every read and write
+ *
+ * @param      src    Compressed bytes
+ * @param[in]  n      Number of compressed bytes
+ * @param      dst    Destination
+ * @param[in]  out_n  Expected number of decompressed bytes
+ *
+ * @return     true if src decompressed to exactly out_n bytes; false otherwise
+ */
+static bool lz_decompress(const uint8 *src, size_t n, uint8 *dst, size_t out_n) {
+    size_t ip = 0;
+    size_t op = 0;
+
+    while (ip < n) {
+        uint8 token = src[ip++];
+        size_t literals = token >> 4;
+        size_t match = token & 0x0f;
+        size_t offset;
+        uint8 b;
+
+        if (literals == 15) {
+            do {
+                if (ip >= n) {
+                    return false;
+                }
+                b = src[ip++];
+                literals += b;
+            } while (b == 255);
+        }
+
+        if (literals > n - ip || literals > out_n - op) {
+            return false;
+        }
+        memcpy(dst + op, src + ip, literals);
+        ip += literals;
+        op += literals;
+
+        // The last sequence has no match
+        if (ip == n) {
+            break;
+        }
+
+        if (n - ip < 2) {
+            return false;
+        }
+        offset = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op) {
+            return false;
+        }
+
+        if (match == 15) {
+            do {
+                if (ip >= n) {
+                    return false;
+                }
+                b = src[ip++];
+                match += b;
+            } while (b == 255);
+        }
+        match += LZ_MIN_MATCH;
+
+        if (match > out_n - op) {
+            return false;
+        }
+        // Byte by byte: source and destination may overlap
+        while (match--) {
+            dst[op] = dst[op - offset];
+            ++op;
+        }
+    }
+
+    return op == out_n;
+}
+
+/**
+ * @brief      Gets the uncompressed payload size for the current world
+ *
+ * @return     Size in bytes
+ */
+static size_t snapshot_get_raw_size() {
+    return sizeof(SnapshotWorld) + sizeof(SnapshotShip) * (ship2 ? 2 : 1)
+           + sizeof(SnapshotBlast) * num_blasts
+           + sizeof(SnapshotAsteroid) * num_asteroids;
+}
+
+/**
+ * @brief      Makes a position record
+ *
+ * @param      motion  The entity's motion, which has the fixed-point position
+ * @param[in]  x       x position
+ * @param[in]  y       y position
+ *
+ * @return     The record
+ */
+static SnapshotPos snapshot_put_pos(const SimMotion *motion, float x, float y) {
+    SnapshotPos pos;
+
+#ifdef WAS_FIXED_POINT
+    pos.x = (uint32)motion->x;
+    pos.y = (uint32)motion->y;
+#else
+    memcpy(&pos.x, &x, 4);
+    memcpy(&pos.y, &y, 4);
+#endif // WAS_FIXED_POINT
+
+    return pos;
+}
+
+/**
+ * @brief      Reads a position record as floats
+ *
+ * @param[in]  pos   The record
+ * @param[out] x     x position
+ * @param[out] y     y position
+ */
+static void snapshot_get_pos(SnapshotPos pos, float *x, float *y) {
+#ifdef WAS_FIXED_POINT
+    *x = fixed_to_float((fixed)pos.x);
+    *y = fixed_to_float((fixed)pos.y);
+#else
+    memcpy(x, &pos.x, 4);
+    memcpy(y, &pos.y, 4);
+#endif // WAS_FIXED_POINT
+}
+
+/**
+ * @brief      Puts an entity made from a record exactly where it was saved
+ *
+ * @param      motion  The entity's motion
+ * @param[in]  pos     The record
+ */
+static void snapshot_place(SimMotion *motion, SnapshotPos pos) {
+    float x;
+    float y;
+
+    snapshot_get_pos(pos, &x, &y);
+    sim_place(motion, x, y);
+#ifdef WAS_FIXED_POINT
+    // The float view can't hold every fixed-point position
+    motion->x = (fixed)pos.x;
+    motion->y = (fixed)pos.y;
+#endif // WAS_FIXED_POINT
+}
+
+/**
+ * @brief      Writes a ship record
+ *
+ * @param      buf   Destination
+ * @param      from  The ship
+ */
+static void snapshot_write_ship(uint8 *buf, Ship *from) {
+    SnapshotShip s;
+
+    s.pos = snapshot_put_pos(&from->motion, from->x, from->y);
+    s.direction = from->direction;
+    s.scale = from->scale;
+    s.speed = from->speed;
+    s.lives = from->lives;
+    s.can_be_hit = from->can_be_hit;
+    s.can_be_hit_count = from->can_be_hit_count;
+    memcpy(buf, &s, sizeof(s));
+}
+
+/**
+ * @brief      Makes a ship out of a ship record
+ *
+ * @param      buf   Source
+ *
+ * @return     Pointer to new ship
+ */
+static Ship * snapshot_read_ship(const uint8 *buf) {
+    SnapshotShip s;
+    Ship *to = ship_make_new_default();
+
+    memcpy(&s, buf, sizeof(s));
+    snapshot_get_pos(s.pos, &to->x, &to->y);
+    snapshot_place(&to->motion, s.pos);
+    to->direction = s.direction;
+    to->scale = s.scale;
+    to->speed = s.speed;
+    to->lives = (int8)s.lives;
+    to->can_be_hit = s.can_be_hit != 0;
+    to->can_be_hit_count = (int16)s.can_be_hit_count;
+
+    return to;
+}
+
+/**
+ * @brief      Writes the uncompressed payload for the current world
+ *
+ * @param      buf   Destination, snapshot_get_raw_size() bytes
+ */
+static void snapshot_write_raw(uint8 *buf) {
+    SnapshotWorld world;
+    int32 i;
+
+    world.score_count = score_count;
+    world.is_game_over = is_game_over;
+    world.sim_rng_seed = sim_rng_seed;
+    world.sim_tick = sim_tick;
+    world.num_ships = ship2 ? 2 : 1;
+    world.num_blasts = num_blasts;
+    world.num_asteroids = num_asteroids;
+    memcpy(buf, &world, sizeof(world));
+    buf += sizeof(world);
+
+    snapshot_write_ship(buf, ship);
+    buf += sizeof(SnapshotShip);
+    if (ship2) {
+        snapshot_write_ship(buf, ship2);
+        buf += sizeof(SnapshotShip);
+    }
+
+    for (i = 0; i < num_blasts; ++i) {
+        SnapshotBlast *b = (SnapshotBlast *)buf;
+
+        b->pos = snapshot_put_pos(&blasts[i]->motion, blasts[i]->x, blasts[i]->y);
+        b->direction = blasts[i]->direction;
+        b->size = blasts[i]->size;
+        b->speed = blasts[i]->speed;
+        buf += sizeof(SnapshotBlast);
+    }
+
+    for (i = 0; i < num_asteroids; ++i) {
+        SnapshotAsteroid *a = (SnapshotAsteroid *)buf;
+
+        a->pos = snapshot_put_pos(&asteroids[i]->motion, asteroids[i]->x, asteroids[i]->y);
+        a->direction = asteroids[i]->direction;
+        a->scale = asteroids[i]->scale;
+        a->speed = asteroids[i]->speed;
+        a->shape = asteroids[i]->shape;
+        a->id = asteroids[i]->id;
+        buf += sizeof(SnapshotAsteroid);
+    }
+}
+
+/**
+ * @brief      Checks a saved position against the bounds it was saved in
+ *
+ * @param[in]  pos     The record
+ * @param      header  The snapshot header
+ *
+ * @return     true if the position is finite and in (or just past) the world
+ */
+static bool snapshot_check_pos(SnapshotPos pos, const SnapshotHeader *header) {
+    float x;
+    float y;
+
+    snapshot_get_pos(pos, &x, &y);
+    return isfinite(x) && isfinite(y)
+           && x >= -SNAPSHOT_EDGE_SLACK && x <= header->world_width + SNAPSHOT_EDGE_SLACK
+           && y >= -SNAPSHOT_EDGE_SLACK && y <= header->world_height + SNAPSHOT_EDGE_SLACK;
+}
+
+/**
+ * @brief      Checks the records of an uncompressed payload
+ *
+ * @param      buf     First ship record
+ * @param[in]  world   The world record
+ * @param      header  The snapshot header
+ *
+ * @return     true if every record holds sane values
+ */
+static bool snapshot_check_records(const uint8 *buf, const SnapshotWorld *world,
+                                   const SnapshotHeader *header) {
+    uint32 i;
+
+    for (i = 0; i < world->num_ships; ++i) {
+        SnapshotShip s;
+
+        memcpy(&s, buf, sizeof(s));
+        buf += sizeof(s);
+        if (!snapshot_check_pos(s.pos, header) || !isfinite(s.direction)
+                || !isfinite(s.scale) || s.scale <= 0 || !isfinite(s.speed)) {
+            return false;
+        }
+    }
+
+    for (i = 0; i < world->num_blasts; ++i) {
+        SnapshotBlast b;
+
+        memcpy(&b, buf, sizeof(b));
+        buf += sizeof(b);
+        if (!snapshot_check_pos(b.pos, header) || !isfinite(b.direction)
+                || !isfinite(b.size) || b.size <= 0 || !isfinite(b.speed)) {
+            return false;
+        }
+    }
+
+    for (i = 0; i < world->num_asteroids; ++i) {
+        SnapshotAsteroid a;
+
+        memcpy(&a, buf, sizeof(a));
+        buf += sizeof(a);
+        if (!snapshot_check_pos(a.pos, header) || !isfinite(a.direction)
+                || !isfinite(a.scale) || a.scale <= 0 || !isfinite(a.speed)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief      Replaces the current world with an uncompressed payload
+ *
+ * @param      buf     Payload in host byte order
+ * @param[in]  size    Payload size
+ * @param      header  The snapshot header
+ *
+ * @return     true on success; false if the payload is malformed (world untouched)
+ */
+static bool snapshot_read_raw(const uint8 *buf, size_t size, const SnapshotHeader *header) {
+    SnapshotWorld world;
+    uint32 i;
+
+    if (size < sizeof(world)) {
+        return false;
+    }
+    memcpy(&world, buf, sizeof(world));
+    buf += sizeof(world);
+
+    if (world.num_ships < 1 || world.num_ships > 2
+            || world.num_blasts > BLAST_MAX || world.num_asteroids > ASTEROID_MAX
+            || size != sizeof(world) + sizeof(SnapshotShip) * world.num_ships
+                       + sizeof(SnapshotBlast) * world.num_blasts
+                       + sizeof(SnapshotAsteroid) * world.num_asteroids
+            || !snapshot_check_records(buf, &world, header)) {
+        return false;
+    }
+
+    game_end();
+    world_set_bounds((int32)header->world_width, (int32)header->world_height);
+
+    ship = snapshot_read_ship(buf);
+    buf += sizeof(SnapshotShip);
+    if (world.num_ships == 2) {
+        ship2 = snapshot_read_ship(buf);
+        ship2->color = SHIP2_COLOR;
+        buf += sizeof(SnapshotShip);
+    }
+
+    for (i = 0; i < world.num_blasts; ++i) {
+        SnapshotBlast b;
+        Blast *blast;
+        float x;
+        float y;
+
+        memcpy(&b, buf, sizeof(b));
+        buf += sizeof(b);
+
+        snapshot_get_pos(b.pos, &x, &y);
+        blast = blast_make_new_default(x, y, b.direction);
+        snapshot_place(&blast->motion, b.pos);
+        blast->size = b.size;
+        blast->speed = b.speed;
+    }
+
+    for (i = 0; i < world.num_asteroids; ++i) {
+        SnapshotAsteroid a;
+        Asteroid *asteroid;
+        float x;
+        float y;
+
+        memcpy(&a, buf, sizeof(a));
+        buf += sizeof(a);
+
+        snapshot_get_pos(a.pos, &x, &y);
+        asteroid = asteroid_make_new_default(x, y, a.direction, a.scale);
+        if (!asteroid) {
+            break;
+        }
+        snapshot_place(&asteroid->motion, a.pos);
+        asteroid->speed = a.speed;
+        asteroid->shape = (uint8)((uint32)a.shape % ASTEROID_SHAPES);
+        asteroid->id = a.id;
+    }
+
+    score_count = world.score_count;
+    is_game_over = world.is_game_over != 0;
+    sim_rng_seed = world.sim_rng_seed;
+    sim_tick = world.sim_tick;
+
+    return true;
+}
+
+/**
+ * @brief      Gets the largest size a snapshot of the current world can take
+ *
+ * @return     Size in bytes
+ */
+size_t snapshot_get_max_size() {
+    return sizeof(SnapshotHeader) + LZ_BOUND(snapshot_get_raw_size());
+}
+
+/**
+ * @brief      Gets the largest size a snapshot of any world can take
+ *
+ * @return     Size in bytes
+ */
+size_t snapshot_get_capacity() {
+    return sizeof(SnapshotHeader) + LZ_BOUND(SNAPSHOT_RAW_MAX);
+}
+
+/**
+ * @brief      Saves the current world into buf
+ *
+ * @param      buf       Destination
+ * @param[in]  capacity  Size of buf, snapshot_get_max_size() is always enough
+ * @param[in]  compress  Whether to compress the payload
+ *
+ * @return     Number of bytes written, or 0 if buf is too small
+ */
+size_t snapshot_save(uint8 *buf, size_t capacity, bool compress) {
+    SnapshotHeader header;
+    size_t raw_size = snapshot_get_raw_size();
+    size_t stored_size;
+    uint8 *payload = buf + sizeof(header);
+
+    if (capacity < sizeof(header) + (compress ? LZ_BOUND(raw_size) : raw_size)) {
+        return 0;
+    }
+
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.flags = SNAPSHOT_BUILD_FLAGS;
+    header.raw_size = (uint32)raw_size;
+    header.world_width = (uint32)world_bounds.width;
+    header.world_height = (uint32)world_bounds.height;
+
+    if (compress) {
+        uint8 *raw = (uint8 *) malloc(raw_size);
+
+        if (!raw) {
+            return 0;
+        }
+        snapshot_write_raw(raw);
+        snapshot_swap_words(raw, raw_size);
+        stored_size = lz_compress(raw, raw_size, payload);
+        header.flags |= SNAPSHOT_COMPRESSED;
+        free(raw);
+    }
+    else {
+        snapshot_write_raw(payload);
+        snapshot_swap_words(payload, raw_size);
+        stored_size = raw_size;
+    }
+
+    header.stored_size = (uint32)stored_size;
+    snapshot_swap_words(&header, sizeof(header));
+    memcpy(buf, &header, sizeof(header));
+
+    return sizeof(header) + stored_size;
+}
+
+/**
+ * @brief      Replaces the current world with a snapshot
+ *
+ * @param      buf   Snapshot bytes
+ * @param[in]  size  Number of bytes
+ *
+ * @return     true on success; false if the snapshot is invalid (world untouched)
+ */
+bool snapshot_load(const uint8 *buf, size_t size) {
+    SnapshotHeader header;
+    uint8 *raw;
+    bool ok;
+
+    if (size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, buf, sizeof(header));
+    snapshot_swap_words(&header, sizeof(header));
+
+    if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION
+            || header.stored_size != size - sizeof(header)
+            || (header.flags & SNAPSHOT_FIXED_POINT) != SNAPSHOT_BUILD_FLAGS
+            || header.raw_size % 4 != 0 || header.raw_size > SNAPSHOT_RAW_MAX
+            || header.world_width == 0 || header.world_width > SNAPSHOT_WORLD_MAX
+            || header.world_height == 0 || header.world_height > SNAPSHOT_WORLD_MAX) {
+        return false;
+    }
+
+    raw = (uint8 *) malloc(header.raw_size ? header.raw_size : 1);
+    if (!raw) {
+        return false;
+    }
+    if (header.flags & SNAPSHOT_COMPRESSED) {
+        ok = lz_decompress(buf + sizeof(header), header.stored_size, raw, header.raw_size);
+    }
+    else {
+        ok = header.stored_size == header.raw_size;
+        if (ok) {
+            memcpy(raw, buf + sizeof(header), header.raw_size);
+        }
+    }
+
+    if (ok) {
+        snapshot_swap_words(raw, header.raw_size);
+        ok = snapshot_read_raw(raw, header.raw_size, &header);
+    }
+    free(raw);
+
+    return ok;
+}
+
+/**
+ * @brief      Saves the current world to a file, through the I/O worker
+ *
+ * @param[in]  filename  The file
+ * @param[in]  compress  Whether to compress the payload
+ *
+ * @return     true if the write was queued; false otherwise
+ */
+bool snapshot_save_file(const char *filename, bool compress) {
+    size_t capacity = snapshot_get_max_size();
+    uint8 *buf = (uint8 *) malloc(capacity);
+    size_t size = buf ? snapshot_save(buf, capacity, compress) : 0;
+
+    if (size == 0) {
+        free(buf);
+        return false;
+    }
+
+    return io_write_file(filename, buf, size);
+}
+
+/**
+ * @brief      Replaces the current world with the snapshot in a file
+ *
+ * @param[in]  filename  The file
+ *
+ * @return     true on success; false otherwise (world untouched)
+ */
+bool snapshot_load_file(const char *filename) {
+    ALLEGRO_FILE *file;
+    int64 size;
+    uint8 *buf;
+    size_t pending_size;
+    bool ok = false;
+
+    // A save still on its way to the disk is taken from the I/O queue
+    buf = io_read_pending(filename, &pending_size);
+    if (buf) {
+        ok = snapshot_load(buf, pending_size);
+        free(buf);
+        return ok;
+    }
+
+    file = al_fopen(filename, "rb");
+    if (!file) {
+        return false;
+    }
+
+    size = al_fsize(file);
+    // Anything bigger than the largest possible snapshot isn't one
+    if (size > 0 && (uint64)size <= snapshot_get_capacity()) {
+        buf = (uint8 *) malloc((size_t)size);
+        ok = buf && al_fread(file, buf, (size_t)size) == (size_t)size
+             && snapshot_load(buf, (size_t)size);
+        free(buf);
+    }
+    al_fclose(file);
+
+    return ok;
+}
+
+/**
+ * @brief      Gets the quick-save file path
+ *
+ * @return     Path, to be destroyed by the caller; NULL if there's no user data path
+ */
+static ALLEGRO_PATH * snapshot_get_quick_path() {
+    ALLEGRO_PATH *path = al_get_standard_path(ALLEGRO_USER_DATA_PATH);
+
+    if (path) {
+        al_make_directory(al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP));
+        al_set_path_filename(path, "quicksave.sav");
+    }
+
+    return path;
+}
+
+/**
+ * @brief      Saves the current world to the quick-save slot
+ *
+ * @return     true on success; false otherwise
+ */
+bool snapshot_quick_save() {
+    ALLEGRO_PATH *path = snapshot_get_quick_path();
+    bool ok;
+
+    if (!path) {
+        return false;
+    }
+
+    ok = snapshot_save_file(al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP), true);
+    al_destroy_path(path);
+
+    return ok;
+}
+
+/**
+ * @brief      Loads the world from the quick-save slot
+ *
+ * @return     true on success; false otherwise (world untouched)
+ */
+bool snapshot_quick_load() {
+    ALLEGRO_PATH *path = snapshot_get_quick_path();
+    bool ok;
+
+    if (!path) {
+        return false;
+    }
+
+    ok = snapshot_load_file(al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP));
+    al_destroy_path(path);
+
+    return ok;
+}
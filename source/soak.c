@@ -0,0 +1,205 @@
+/*
+ *
+ * MIT License
+ * 
+ * Copyright (c) 2017 Wilk Maia
+ * wilkmaia [at] gmail [dot] com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ */
+
+
+/**
+ * Soak test functions
+ *
+ * Keeps the game running for hours under the autopilot and logs tick time
+ * percentiles, resident memory and entity counts once every SOAK_LOG_INTERVAL
+ * seconds, so slow leaks and latency creep show up as trends in the log.
+ */
+
+#define WAS_USING_SHIP
+#define WAS_USING_BLAST
+#define WAS_USING_ASTEROID
+#define WAS_USING_SOAK
+#include "wasteroids.h"
+
+#ifdef __linux__
+    #include <unistd.h>
+#endif // __linux__
+
+
+/*=========================================
+=            Local definitions            =
+=========================================*/
+
+/**
+ * Max tick samples kept per log interval
+ */
+#define SOAK_MAX_SAMPLES 16384
+
+static bool running = false;
+static double start_time;
+static double end_time;
+static double last_log_time;
+static uint32 games_played;
+static uint64 total_ticks;
+static double *samples = NULL;
+static int32 num_samples;
+
+/*=====  End of Local definitions  ======*/
+
+
+
+/**
+ * @brief      Gets the resident set size of the process
+ *
+ * @return     RSS in kilobytes, or 0 where unsupported
+ */
+static long soak_get_rss_kb() {
+    long rss_kb = 0;
+#ifdef __linux__
+    FILE *statm = fopen("/proc/self/statm", "r");
+    long pages;
+
+    if (statm) {
+        if (fscanf(statm, "%*s %ld", &pages) == 1) {
+            rss_kb = pages * (sysconf(_SC_PAGESIZE) / 1024);
+        }
+        fclose(statm);
+    }
+#endif // __linux__
+
+    return rss_kb;
+}
+
+/**
+ * @brief      Compares two tick samples, for qsort
+ */
+static int soak_compare_samples(const void *a, const void *b) {
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+
+    return (da > db) - (da < db);
+}
+
+/**
+ * @brief      Prints a log line for the samples gathered so far and starts a new interval
+ *
+ * @param[in]  now   Current time
+ */
+static void soak_log(double now) {
+    double p50 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+
+    if (num_samples > 0) {
+        qsort(samples, num_samples, sizeof(double), soak_compare_samples);
+        p50 = samples[num_samples / 2];
+        p99 = samples[(num_samples * 99) / 100];
+        max = samples[num_samples - 1];
+    }
+
+    printf("soak %8.0fs ticks=%llu games=%u tick_us p50=%.1f p99=%.1f max=%.1f "
+           "rss_kb=%ld asteroids=%d blasts=%d\n",
+           now - start_time, (unsigned long long)total_ticks, games_played,
+           p50 * 1e6, p99 * 1e6, max * 1e6,
+           soak_get_rss_kb(), num_asteroids, num_blasts);
+    fflush(stdout);
+
+    num_samples = 0;
+    last_log_time = now;
+}
+
+/**
+ * @brief      Starts a soak test
+ *
+ * @param[in]  hours  Test duration
+ */
+void soak_init(double hours) {
+    samples = (double *) malloc(sizeof(double) * SOAK_MAX_SAMPLES);
+    num_samples = 0;
+    total_ticks = 0;
+    games_played = 1;
+
+    start_time = al_get_time();
+    end_time = start_time + hours * 3600.0;
+    last_log_time = start_time;
+    running = true;
+
+    soak_log(start_time);
+}
+
+/**
+ * @brief      Logs the last interval and frees the soak test's memory
+ */
+void soak_shutdown() {
+    if (!running) {
+        return;
+    }
+
+    soak_log(al_get_time());
+
+    free(samples);
+    samples = NULL;
+    running = false;
+}
+
+/**
+ * @brief      Checks if a soak test is running
+ *
+ * @return     true if running; false otherwise
+ */
+bool soak_is_running() {
+    return running;
+}
+
+/**
+ * @brief      Records the duration of one simulation tick
+ *
+ * @param[in]  seconds  Tick duration
+ */
+void soak_record_tick(double seconds) {
+    ++total_ticks;
+
+    // Past the sample cap the interval's percentiles only cover its start
+    if (num_samples < SOAK_MAX_SAMPLES) {
+        samples[num_samples++] = seconds;
+    }
+}
+
+/**
+ * @brief      Restarts finished games and logs when an interval is over
+ *
+ * @return     true while the test should keep going; false once its time is up
+ */
+bool soak_update() {
+    double now = al_get_time();
+
+    if (is_game_over || num_asteroids == 0) {
+        game_restart();
+        ++games_played;
+    }
+
+    if (now - last_log_time >= SOAK_LOG_INTERVAL) {
+        soak_log(now);
+    }
+
+    return now < end_time;
+}
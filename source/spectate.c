@@ -0,0 +1,769 @@
+/*
+ *
+ * MIT License
+ * 
+ * Copyright (c) 2017 Wilk Maia
+ * wilkmaia [at] gmail [dot] com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ */
+
+
+/**
+ * Spectator functions
+ *
+ * A broadcasting game sends its world to viewers over UDP every tick.
+ * Positions and angles are quantized, and each packet only carries the
+ * fields that changed since the last state the viewer acknowledged
+ * (a keyframe when there's none), so a lost packet never needs to be
+ * resent and a packet never exceeds SPECTATE_PACKET_MAX bytes, however
+ * crowded the world gets. Viewers rebuild the world out of what they get
+ * and draw it with the regular draw functions.
+ *
+ * Viewers keep sending their acknowledgements, which also subscribes them;
+ * the broadcaster forgets about viewers that go silent.
+ */
+
+#define WAS_USING_SHIP
+#define WAS_USING_BLAST
+#define WAS_USING_ASTEROID
+#define WAS_USING_SPECTATE
+#include "wasteroids.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+/*=========================================
+=            Local definitions            =
+=========================================*/
+
+#define SPECTATE_MAGIC 0x56534157 // "WASV"
+
+/**
+ * Baseline tick of keyframes, and ack of viewers that have nothing yet
+ */
+#define SPECTATE_NO_TICK 0xffffffffu
+
+/**
+ * World states kept on both sides to delta against
+ */
+#define SPECTATE_HISTORY 32
+
+#define SPECTATE_MAX_VIEWERS 8
+#define SPECTATE_VIEWER_TIMEOUT 5.0
+
+/**
+ * Quantization: positions in half pixels from -1024, angles in 1/256 turns,
+ * asteroid scale in 1/16
+ */
+#define SPECTATE_POS_OFFSET 1024.0f
+#define SPECTATE_POS_STEPS 2.0f
+#define SPECTATE_SCALE_STEPS 16.0f
+
+/**
+ * Changed field bits of a delta-encoded entity
+ */
+#define FIELD_X         0x01
+#define FIELD_Y         0x02
+#define FIELD_DIRECTION 0x04
+#define FIELD_SCALE     0x08
+#define FIELD_SHAPE     0x10
+#define FIELD_ALL       0x1f
+
+typedef struct {
+    uint16 x;
+    uint16 y;
+    uint8 direction;
+    uint8 scale;
+    uint8 shape;
+} SpectateEntity;
+
+typedef struct {
+    uint16 x;
+    uint16 y;
+    uint8 direction;
+    int8 lives;
+    uint8 can_be_hit;
+    uint16 can_be_hit_count;
+} SpectateShip;
+
+typedef struct {
+    uint32 tick;
+    bool valid;
+    uint16 width;
+    uint16 height;
+    uint32 score;
+    uint8 is_game_over;
+    uint8 num_ships;
+    SpectateShip ships[2];
+    uint8 num_blasts;
+    SpectateEntity blasts[BLAST_MAX];
+    uint8 num_asteroids;
+    SpectateEntity asteroids[ASTEROID_MAX];
+} SpectateState;
+
+typedef struct {
+    struct sockaddr_in addr;
+    uint32 acked;
+    double last_seen;
+} SpectateViewer;
+
+typedef struct {
+    const uint8 *p;
+    const uint8 *end;
+    bool ok;
+} SpectateReader;
+
+static bool broadcasting = false;
+static bool viewing = false;
+static int sock = -1;
+static SpectateState history[SPECTATE_HISTORY];
+static uint32 current_tick;
+
+// Broadcaster
+static SpectateViewer viewers[SPECTATE_MAX_VIEWERS];
+static int32 num_viewers;
+static uint64 bytes_sent;
+static uint64 packets_sent;
+
+// Viewer
+static struct sockaddr_in broadcaster_addr;
+static uint32 newest_tick;
+
+/*=====  End of Local definitions  ======*/
+
+
+
+/**
+ * @brief      Opens the non-blocking UDP socket, bound to port (0 for any)
+ *
+ * @param[in]  port  The port
+ */
+static void spectate_open_socket(int32 port) {
+    struct sockaddr_in addr;
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        error("Couldn't create spectator socket");
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16)port);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        error("Couldn't bind spectator socket");
+    }
+
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+}
+
+static uint16 spectate_quantize_pos(float v) {
+    float q = (v + SPECTATE_POS_OFFSET) * SPECTATE_POS_STEPS;
+
+    if (q < 0.0f) {
+        return 0;
+    }
+    if (q > 65535.0f) {
+        return 65535;
+    }
+    return (uint16)(q + 0.5f);
+}
+
+static float spectate_dequantize_pos(uint16 q) {
+    return q / SPECTATE_POS_STEPS - SPECTATE_POS_OFFSET;
+}
+
+static uint8 spectate_quantize_angle(float angle) {
+    return (uint8)((int32)floorf(angle / MAX_ANGLE * 256.0f + 0.5f) & 0xff);
+}
+
+static float spectate_dequantize_angle(uint8 q) {
+    return q * MAX_ANGLE / 256.0f;
+}
+
+static uint8 * spectate_put16(uint8 *p, uint16 v) {
+    p[0] = (uint8)(v & 0xff);
+    p[1] = (uint8)(v >> 8);
+    return p + 2;
+}
+
+static uint8 * spectate_put32(uint8 *p, uint32 v) {
+    p = spectate_put16(p, (uint16)(v & 0xffff));
+    return spectate_put16(p, (uint16)(v >> 16));
+}
+
+static uint8 spectate_get8(SpectateReader *r) {
+    if (r->p >= r->end) {
+        r->ok = false;
+        return 0;
+    }
+    return *(r->p++);
+}
+
+static uint16 spectate_get16(SpectateReader *r) {
+    uint16 lo = spectate_get8(r);
+    return (uint16)(lo | (spectate_get8(r) << 8));
+}
+
+static uint32 spectate_get32(SpectateReader *r) {
+    uint32 lo = spectate_get16(r);
+    return lo | ((uint32)spectate_get16(r) << 16);
+}
+
+/**
+ * @brief      Quantizes the current world
+ *
+ * @param      state  Destination
+ */
+static void spectate_capture(SpectateState *state) {
+    Ship *ships[2];
+    int32 i;
+
+    ships[0] = ship;
+    ships[1] = ship2;
+
+    state->tick = current_tick;
+    state->valid = true;
+    state->score = score_count;
+    state->is_game_over = is_game_over;
+
+    state->num_ships = ship2 ? 2 : 1;
+    for (i = 0; i < state->num_ships; ++i) {
+        state->ships[i].x = spectate_quantize_pos(ships[i]->x);
+        state->ships[i].y = spectate_quantize_pos(ships[i]->y);
+        state->ships[i].direction = spectate_quantize_angle(ships[i]->direction);
+        state->ships[i].lives = ships[i]->lives;
+        state->ships[i].can_be_hit = ships[i]->can_be_hit;
+        state->ships[i].can_be_hit_count = (uint16)ships[i]->can_be_hit_count;
+    }
+
+    state->num_blasts = (uint8)num_blasts;
+    for (i = 0; i < num_blasts; ++i) {
+        state->blasts[i].x = spectate_quantize_pos(blasts[i]->x);
+        state->blasts[i].y = spectate_quantize_pos(blasts[i]->y);
+        state->blasts[i].direction = spectate_quantize_angle(blasts[i]->direction);
+        state->blasts[i].scale = 0;
+        state->blasts[i].shape = 0;
+    }
+
+    state->num_asteroids = (uint8)num_asteroids;
+    for (i = 0; i < num_asteroids; ++i) {
+        state->asteroids[i].x = spectate_quantize_pos(asteroids[i]->x);
+        state->asteroids[i].y = spectate_quantize_pos(asteroids[i]->y);
+        state->asteroids[i].direction = spectate_quantize_angle(asteroids[i]->direction);
+        state->asteroids[i].scale = (uint8)(asteroids[i]->scale * SPECTATE_SCALE_STEPS + 0.5f);
+        state->asteroids[i].shape = asteroids[i]->shape;
+    }
+}
+
+/**
+ * @brief      Writes an entity list, only with the fields that changed since base
+ *
+ * @param      p       Destination
+ * @param      cur     Current entities
+ * @param[in]  n       Number of current entities
+ * @param      base    Baseline entities
+ * @param[in]  base_n  Number of baseline entities (0 for a keyframe)
+ *
+ * @return     End of the written list
+ */
+static uint8 * spectate_write_list(uint8 *p, const SpectateEntity *cur, int32 n,
+                                   const SpectateEntity *base, int32 base_n) {
+    uint8 *changed;
+    int32 i;
+
+    *p++ = (uint8)n;
+    changed = p;
+    memset(changed, 0, (n + 7) / 8);
+    p += (n + 7) / 8;
+
+    for (i = 0; i < n; ++i) {
+        uint8 fields = FIELD_ALL;
+
+        if (i < base_n) {
+            fields = 0;
+            fields |= (cur[i].x != base[i].x) ? FIELD_X : 0;
+            fields |= (cur[i].y != base[i].y) ? FIELD_Y : 0;
+            fields |= (cur[i].direction != base[i].direction) ? FIELD_DIRECTION : 0;
+            fields |= (cur[i].scale != base[i].scale) ? FIELD_SCALE : 0;
+            fields |= (cur[i].shape != base[i].shape) ? FIELD_SHAPE : 0;
+        }
+        if (!fields) {
+            continue;
+        }
+
+        changed[i / 8] |= (uint8)(1 << (i % 8));
+        *p++ = fields;
+        if (fields & FIELD_X) {
+            p = spectate_put16(p, cur[i].x);
+        }
+        if (fields & FIELD_Y) {
+            p = spectate_put16(p, cur[i].y);
+        }
+        if (fields & FIELD_DIRECTION) {
+            *p++ = cur[i].direction;
+        }
+        if (fields & FIELD_SCALE) {
+            *p++ = cur[i].scale;
+        }
+        if (fields & FIELD_SHAPE) {
+            *p++ = cur[i].shape;
+        }
+    }
+
+    return p;
+}
+
+/**
+ * @brief      Reads an entity list written by spectate_write_list
+ *
+ * @param      r     The reader
+ * @param      list  Baseline entities on input, current ones on output
+ * @param[in]  max   List capacity
+ *
+ * @return     Number of entities
+ */
+static uint8 spectate_read_list(SpectateReader *r, SpectateEntity *list, int32 max) {
+    uint8 changed[(ASTEROID_MAX + 7) / 8];
+    uint8 n = spectate_get8(r);
+    int32 i;
+
+    if (n > max) {
+        r->ok = false;
+        return 0;
+    }
+
+    for (i = 0; i < (n + 7) / 8; ++i) {
+        changed[i] = spectate_get8(r);
+    }
+
+    for (i = 0; i < n && r->ok; ++i) {
+        uint8 fields;
+
+        if (!(changed[i / 8] & (1 << (i % 8)))) {
+            continue;
+        }
+
+        fields = spectate_get8(r);
+        if (fields & FIELD_X) {
+            list[i].x = spectate_get16(r);
+        }
+        if (fields & FIELD_Y) {
+            list[i].y = spectate_get16(r);
+        }
+        if (fields & FIELD_DIRECTION) {
+            list[i].direction = spectate_get8(r);
+        }
+        if (fields & FIELD_SCALE) {
+            list[i].scale = spectate_get8(r);
+        }
+        if (fields & FIELD_SHAPE) {
+            list[i].shape = spectate_get8(r) % ASTEROID_SHAPES;
+        }
+    }
+
+    return n;
+}
+
+/**
+ * @brief      Encodes a state against a baseline
+ *
+ * @param      p     Destination, SPECTATE_PACKET_MAX bytes
+ * @param      cur   Current state
+ * @param      base  Baseline state, or NULL for a keyframe
+ *
+ * @return     Packet size
+ */
+static int32 spectate_encode(uint8 *p, const SpectateState *cur, const SpectateState *base) {
+    uint8 *start = p;
+    int32 i;
+
+    p = spectate_put32(p, SPECTATE_MAGIC);
+    p = spectate_put32(p, cur->tick);
+    p = spectate_put32(p, base ? base->tick : SPECTATE_NO_TICK);
+    p = spectate_put16(p, (uint16)world_bounds.width);
+    p = spectate_put16(p, (uint16)world_bounds.height);
+    p = spectate_put32(p, cur->score);
+    *p++ = cur->is_game_over;
+
+    // Ships change nearly every tick, no point in diffing them
+    *p++ = cur->num_ships;
+    for (i = 0; i < cur->num_ships; ++i) {
+        p = spectate_put16(p, cur->ships[i].x);
+        p = spectate_put16(p, cur->ships[i].y);
+        *p++ = cur->ships[i].direction;
+        *p++ = (uint8)cur->ships[i].lives;
+        *p++ = cur->ships[i].can_be_hit;
+        p = spectate_put16(p, cur->ships[i].can_be_hit_count);
+    }
+
+    p = spectate_write_list(p, cur->blasts, cur->num_blasts,
+                            base ? base->blasts : NULL, base ? base->num_blasts : 0);
+    p = spectate_write_list(p, cur->asteroids, cur->num_asteroids,
+                            base ? base->asteroids : NULL, base ? base->num_asteroids : 0);
+
+    return (int32)(p - start);
+}
+
+/**
+ * @brief      Decodes a packet into a state, against the matching baseline in history
+ *
+ * @param      data   Packet bytes
+ * @param[in]  size   Packet size
+ * @param      state  Destination
+ *
+ * @return     true on success; false if malformed or the baseline is gone
+ */
+static bool spectate_decode(const uint8 *data, int32 size, SpectateState *state) {
+    SpectateReader r;
+    uint32 tick;
+    uint32 base_tick;
+    int32 i;
+
+    r.p = data;
+    r.end = data + size;
+    r.ok = true;
+
+    if (spectate_get32(&r) != SPECTATE_MAGIC) {
+        return false;
+    }
+    tick = spectate_get32(&r);
+    base_tick = spectate_get32(&r);
+
+    if (base_tick == SPECTATE_NO_TICK) {
+        state->num_blasts = 0;
+        state->num_asteroids = 0;
+    }
+    else {
+        const SpectateState *base = &(history[base_tick % SPECTATE_HISTORY]);
+
+        if (!base->valid || base->tick != base_tick) {
+            return false;
+        }
+        *state = *base;
+    }
+    state->tick = tick;
+
+    // World bounds only take effect once the state is applied
+    state->width = spectate_get16(&r);
+    state->height = spectate_get16(&r);
+    if (state->width == 0 || state->height == 0) {
+        return false;
+    }
+    state->score = spectate_get32(&r);
+    state->is_game_over = spectate_get8(&r);
+
+    state->num_ships = spectate_get8(&r);
+    if (state->num_ships < 1 || state->num_ships > 2) {
+        return false;
+    }
+    for (i = 0; i < state->num_ships; ++i) {
+        state->ships[i].x = spectate_get16(&r);
+        state->ships[i].y = spectate_get16(&r);
+        state->ships[i].direction = spectate_get8(&r);
+        state->ships[i].lives = (int8)spectate_get8(&r);
+        state->ships[i].can_be_hit = spectate_get8(&r);
+        state->ships[i].can_be_hit_count = spectate_get16(&r);
+    }
+
+    state->num_blasts = spectate_read_list(&r, state->blasts, BLAST_MAX);
+    state->num_asteroids = spectate_read_list(&r, state->asteroids, ASTEROID_MAX);
+    state->valid = r.ok;
+
+    return r.ok;
+}
+
+/**
+ * @brief      Replaces the current world with a received state
+ *
+ * @param      state  The state
+ */
+static void spectate_apply(const SpectateState *state) {
+    int32 i;
+
+    game_end();
+    world_set_bounds(state->width, state->height);
+
+    for (i = 0; i < state->num_ships; ++i) {
+        Ship *s = ship_make_new_default();
+
+        s->x = spectate_dequantize_pos(state->ships[i].x);
+        s->y = spectate_dequantize_pos(state->ships[i].y);
+        sim_place(&s->motion, s->x, s->y);
+        s->direction = spectate_dequantize_angle(state->ships[i].direction);
+        s->lives = state->ships[i].lives;
+        s->can_be_hit = state->ships[i].can_be_hit != 0;
+        s->can_be_hit_count = (int16)state->ships[i].can_be_hit_count;
+
+        if (i == 0) {
+            ship = s;
+        }
+        else {
+            s->color = SHIP2_COLOR;
+            ship2 = s;
+        }
+    }
+
+    for (i = 0; i < state->num_blasts; ++i) {
+        blast_make_new_default(spectate_dequantize_pos(state->blasts[i].x),
+                               spectate_dequantize_pos(state->blasts[i].y),
+                               spectate_dequantize_angle(state->blasts[i].direction));
+    }
+
+    for (i = 0; i < state->num_asteroids; ++i) {
+        Asteroid *a = asteroid_make_new_default(spectate_dequantize_pos(state->asteroids[i].x),
+                                                spectate_dequantize_pos(state->asteroids[i].y),
+                                                spectate_dequantize_angle(state->asteroids[i].direction),
+                                                state->asteroids[i].scale / SPECTATE_SCALE_STEPS);
+        if (!a) {
+            break;
+        }
+        a->shape = state->asteroids[i].shape;
+    }
+
+    score_count = state->score;
+    is_game_over = state->is_game_over != 0;
+    update_score_text();
+}
+
+/**
+ * @brief      Starts broadcasting the world on a UDP port
+ *
+ * @param[in]  port  The port
+ */
+void spectate_broadcast_init(int32 port) {
+    spectate_open_socket(port);
+    memset(history, 0, sizeof(history));
+    current_tick = 0;
+    num_viewers = 0;
+    bytes_sent = 0;
+    packets_sent = 0;
+    broadcasting = true;
+}
+
+/**
+ * @brief      Starts watching a broadcast
+ *
+ * @param[in]  address  Broadcaster address, as HOST:PORT
+ */
+void spectate_join(const char *address) {
+    struct addrinfo hints;
+    struct addrinfo *res;
+    char host[256];
+    const char *colon = strrchr(address, ':');
+
+    if (!colon || (size_t)(colon - address) >= sizeof(host)) {
+        error("Spectator address should be HOST:PORT");
+    }
+    memcpy(host, address, colon - address);
+    host[colon - address] = 0;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo(host, colon + 1, &hints, &res) != 0 || !res) {
+        error("Couldn't resolve broadcaster host");
+    }
+    memcpy(&broadcaster_addr, res->ai_addr, sizeof(broadcaster_addr));
+    freeaddrinfo(res);
+
+    spectate_open_socket(0);
+    memset(history, 0, sizeof(history));
+    newest_tick = SPECTATE_NO_TICK;
+    viewing = true;
+
+    // Nothing to show until the first state arrives
+    game_end();
+}
+
+/**
+ * @brief      Stops broadcasting or watching
+ */
+void spectate_shutdown() {
+    if (broadcasting && packets_sent > 0) {
+        printf("broadcast: %llu packets, %.1f bytes per packet\n",
+               (unsigned long long)packets_sent, (double)bytes_sent / packets_sent);
+    }
+
+    if (sock >= 0) {
+        close(sock);
+        sock = -1;
+    }
+
+    broadcasting = false;
+    viewing = false;
+}
+
+/**
+ * @brief      Checks if the world is being broadcast
+ *
+ * @return     true if broadcasting; false otherwise
+ */
+bool spectate_is_broadcasting() {
+    return broadcasting;
+}
+
+/**
+ * @brief      Checks if this game is watching a broadcast
+ *
+ * @return     true if watching; false otherwise
+ */
+bool spectate_is_viewing() {
+    return viewing;
+}
+
+/**
+ * @brief      Handles viewer acknowledgements and sends the current world to every viewer
+ */
+void spectate_broadcast() {
+    uint8 data[SPECTATE_PACKET_MAX];
+    struct sockaddr_in from;
+    socklen_t from_len;
+    SpectateState *cur;
+    double now = al_get_time();
+    int32 size;
+    int32 i;
+
+    // Acknowledgements, which also subscribe new viewers
+    while (true) {
+        from_len = sizeof(from);
+        size = (int32)recvfrom(sock, data, sizeof(data), 0, (struct sockaddr *)&from, &from_len);
+        if (size < 0) {
+            break;
+        }
+
+        if (size == 8) {
+            SpectateReader r = {data, data + size, true};
+            uint32 acked;
+
+            if (spectate_get32(&r) != SPECTATE_MAGIC) {
+                continue;
+            }
+            acked = spectate_get32(&r);
+
+            for (i = 0; i < num_viewers; ++i) {
+                if (viewers[i].addr.sin_addr.s_addr == from.sin_addr.s_addr
+                        && viewers[i].addr.sin_port == from.sin_port) {
+                    break;
+                }
+            }
+            if (i == num_viewers) {
+                if (num_viewers == SPECTATE_MAX_VIEWERS) {
+                    continue;
+                }
+                viewers[num_viewers].addr = from;
+                viewers[num_viewers].acked = SPECTATE_NO_TICK;
+                ++num_viewers;
+            }
+
+            // Acks may arrive out of order
+            if (viewers[i].acked == SPECTATE_NO_TICK
+                    || (acked != SPECTATE_NO_TICK && acked > viewers[i].acked)) {
+                viewers[i].acked = acked;
+            }
+            viewers[i].last_seen = now;
+        }
+    }
+
+    cur = &(history[current_tick % SPECTATE_HISTORY]);
+    spectate_capture(cur);
+
+    i = 0;
+    while (i < num_viewers) {
+        const SpectateState *base = NULL;
+        uint32 acked = viewers[i].acked;
+
+        // Forget silent viewers
+        if (now - viewers[i].last_seen > SPECTATE_VIEWER_TIMEOUT) {
+            viewers[i] = viewers[--num_viewers];
+            continue;
+        }
+
+        // Delta against the viewer's last state, if we still have it
+        if (acked != SPECTATE_NO_TICK && current_tick - acked < SPECTATE_HISTORY
+                && history[acked % SPECTATE_HISTORY].tick == acked) {
+            base = &(history[acked % SPECTATE_HISTORY]);
+        }
+
+        size = spectate_encode(data, cur, base);
+        sendto(sock, data, size, 0, (struct sockaddr *)&(viewers[i].addr), sizeof(viewers[i].addr));
+        bytes_sent += size;
+        ++packets_sent;
+        ++i;
+    }
+
+    ++current_tick;
+}
+
+/**
+ * @brief      Reads the broadcast and shows its newest state
+ *
+ * @return     true if the world changed; false otherwise
+ */
+bool spectate_update() {
+    uint8 data[SPECTATE_PACKET_MAX];
+    struct sockaddr_in from;
+    socklen_t from_len;
+    SpectateState state;
+    const SpectateState *newest = NULL;
+    int32 size;
+
+    while (true) {
+        from_len = sizeof(from);
+        size = (int32)recvfrom(sock, data, sizeof(data), 0, (struct sockaddr *)&from, &from_len);
+        if (size < 0) {
+            break;
+        }
+
+        // Only the broadcaster we subscribed to gets to change the world
+        if (from.sin_addr.s_addr != broadcaster_addr.sin_addr.s_addr
+                || from.sin_port != broadcaster_addr.sin_port) {
+            continue;
+        }
+
+        if (!spectate_decode(data, size, &state)) {
+            continue;
+        }
+        history[state.tick % SPECTATE_HISTORY] = state;
+
+        if (newest_tick == SPECTATE_NO_TICK || state.tick > newest_tick) {
+            newest_tick = state.tick;
+            newest = &(history[state.tick % SPECTATE_HISTORY]);
+        }
+    }
+
+    if (newest) {
+        spectate_apply(newest);
+    }
+
+    // Acknowledge, also keeping the subscription alive
+    spectate_put32(data, SPECTATE_MAGIC);
+    spectate_put32(data + 4, newest_tick);
+    sendto(sock, data, 8, 0, (struct sockaddr *)&broadcaster_addr, sizeof(broadcaster_addr));
+
+    return newest != NULL;
+}
@@ -0,0 +1,186 @@
+/*
+ *
+ * MIT License
+ * 
+ * Copyright (c) 2017 Wilk Maia
+ * wilkmaia [at] gmail [dot] com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ */
+
+
+
+/**
+ * Startup functions
+ *
+ * Runs independent startup work on worker threads while the main thread
+ * brings the display up, and measures how long the first frame took.
+ * Jobs must not touch thread-local simulation state, since that belongs
+ * to the main thread. Bitmaps made by a job are memory bitmaps until
+ * startup_wait converts them for the display.
+ */
+
+#define WAS_USING_STARTUP
+#include "wasteroids.h"
+
+
+/*=========================================
+=            Local definitions            =
+=========================================*/
+
+/**
+ * Most jobs that can run at once
+ */
+#define STARTUP_MAX_JOBS 4
+
+typedef struct {
+    const char *name;
+    void (*run)();
+    ALLEGRO_THREAD *thread;
+    double started;
+    double finished;
+} StartupJob;
+
+static StartupJob jobs[STARTUP_MAX_JOBS];
+static int32 num_jobs = 0;
+static double start_time = 0.0;
+static double display_time = 0.0;
+static double wait_time = 0.0;
+static bool report_enabled = false;
+static bool first_frame_shown = false;
+
+/**
+ * @brief      Worker thread: runs one job and times it
+ *
+ * @param      thread  The thread
+ * @param      arg     The job
+ *
+ * @return     NULL
+ */
+static void * startup_job_run(ALLEGRO_THREAD *thread, void *arg) {
+    StartupJob *job = (StartupJob *)arg;
+
+    job->started = al_get_time();
+    job->run();
+    job->finished = al_get_time();
+
+    return NULL;
+}
+
+/*=====  End of Local definitions  ======*/
+
+
+
+/**
+ * @brief      Starts the startup clock. Allegro must be initialised.
+ */
+void startup_begin() {
+    start_time = al_get_time();
+    num_jobs = 0;
+    first_frame_shown = false;
+}
+
+/**
+ * @brief      Runs a job on its own thread, or right away if no thread is free
+ *
+ * @param[in]  name  Name for the report
+ * @param[in]  run   The job
+ */
+void startup_run(const char *name, void (*run)()) {
+    StartupJob *job;
+
+    if (num_jobs == STARTUP_MAX_JOBS) {
+        error("Too many startup jobs");
+    }
+
+    job = &jobs[num_jobs++];
+    job->name = name;
+    job->run = run;
+    job->thread = al_create_thread(startup_job_run, job);
+
+    if (job->thread) {
+        al_start_thread(job->thread);
+    }
+    else {
+        startup_job_run(NULL, job);
+    }
+}
+
+/**
+ * @brief      Notes that the display is up
+ */
+void startup_display_ready() {
+    display_time = al_get_time();
+}
+
+/**
+ * @brief      Waits for every job to finish, and moves the bitmaps they made
+ *             to the current display. Safe to call more than once.
+ */
+void startup_wait() {
+    double waited = al_get_time();
+    int32 i;
+
+    for (i = 0; i < num_jobs; ++i) {
+        if (jobs[i].thread) {
+            al_join_thread(jobs[i].thread, NULL);
+            al_destroy_thread(jobs[i].thread);
+            jobs[i].thread = NULL;
+        }
+    }
+    wait_time += al_get_time() - waited;
+
+    if (al_get_current_display()) {
+        al_convert_memory_bitmaps();
+    }
+}
+
+/**
+ * @brief      Prints the startup report once the first frame is shown
+ */
+void startup_enable_report() {
+    report_enabled = true;
+}
+
+/**
+ * @brief      Notes that a frame was flipped; the first one ends startup
+ */
+void startup_frame_shown() {
+    int32 i;
+
+    if (first_frame_shown) {
+        return;
+    }
+    first_frame_shown = true;
+
+    if (!report_enabled) {
+        return;
+    }
+
+    printf("Startup: first frame after %.1f ms, display up after %.1f ms, "
+           "%.1f ms waiting on workers\n",
+           (al_get_time() - start_time) * 1000.0, (display_time - start_time) * 1000.0,
+           wait_time * 1000.0);
+    for (i = 0; i < num_jobs; ++i) {
+        printf("  %-8s %6.1f ms, from %.1f ms\n", jobs[i].name,
+               (jobs[i].finished - jobs[i].started) * 1000.0,
+               (jobs[i].started - start_time) * 1000.0);
+    }
+}
@@ -53,26 +53,70 @@ void myStrCpy(char *dst, const char *src, size_t MAX_LENGTH) {
     dst[length] = 0;
 }
 
-/*=====  End of Local Definitions  ======*/
+/**
+ * Glyphs an A4-style font bitmap holds, in order: ASCII, Latin-1,
+ * Latin Extended-A and the euro sign
+ */
+static const int FONT_RANGES[] = {
+    0x0020, 0x007f,
+    0x00a1, 0x00ff,
+    0x0100, 0x017f,
+    0x20ac, 0x20ac
+};
+#define NUM_FONT_RANGES ((int)(sizeof(FONT_RANGES) / sizeof(FONT_RANGES[0]) / 2))
 
+/**
+ * Default font loaded ahead of time, taken by the next default text
+ */
+static ALLEGRO_FONT *preloaded_font = NULL;
 
+/**
+ * Where the default font used to be loaded from, only for the benchmark
+ */
+#define DEFAULT_FONT_PATH "fonts/a4_font.tga"
 
 /**
- * @brief      Creates a new text element
+ * @brief      Loads the default font out of the binary
  *
- * @param[in]  font   The font
- * @param[in]  scale  The scale
- * @param[in]  x      absolute x coord on screen
- * @param[in]  y      absolute y coord on screen
- * @param[in]  color  The color
- * @param[in]  msg    The message to print
+ * @return     The font. Allegro's builtin font on builds without one
+ *             embedded, or if it can't be decoded, so there's always one.
+ */
+static ALLEGRO_FONT * text_load_default_font() {
+    ALLEGRO_FONT *font = NULL;
+#ifdef WAS_EMBEDDED_FONT
+    ALLEGRO_FILE *file = al_open_memfile((void *)asset_a4_font, asset_a4_font_size, "r");
+
+    if (file) {
+        ALLEGRO_BITMAP *bitmap = al_load_bitmap_f(file, ".tga");
+
+        if (bitmap) {
+            font = al_grab_font_from_bitmap(bitmap, NUM_FONT_RANGES, FONT_RANGES);
+            al_destroy_bitmap(bitmap);
+        }
+        al_fclose(file);
+    }
+
+    if (!font) {
+        fprintf(stderr, "Embedded font couldn't be decoded, using the builtin one\n");
+    }
+#endif // WAS_EMBEDDED_FONT
+
+    if (!font) {
+        font = al_create_builtin_font();
+    }
+
+    return font;
+}
+
+/**
+ * @brief      Creates a new text element out of a loaded font
  *
  * @return     Pointer to new text element
  */
-text * text_make_new(const char *font, float scale, float x, float y, ALLEGRO_COLOR color, const char *msg) {
+static text * text_make(ALLEGRO_FONT *font, float scale, float x, float y, ALLEGRO_COLOR color, const char *msg) {
     text *newText = (text *)malloc(sizeof(text));
 
-    newText->font = al_load_font(font, 0, 0);
+    newText->font = font;
     newText->scale = scale;
     newText->x = x;
     newText->y = y;
@@ -82,8 +126,29 @@ text * text_make_new(const char *font, float scale, float x, float y, ALLEGRO_CO
     return newText;
 }
 
+/*=====  End of Local Definitions  ======*/
+
+
+
+/**
+ * @brief      Creates a new text element
+ *
+ * @param[in]  font   The font
+ * @param[in]  scale  The scale
+ * @param[in]  x      absolute x coord on screen
+ * @param[in]  y      absolute y coord on screen
+ * @param[in]  color  The color
+ * @param[in]  msg    The message to print
+ *
+ * @return     Pointer to new text element
+ */
+text * text_make_new(const char *font, float scale, float x, float y, ALLEGRO_COLOR color, const char *msg) {
+    return text_make(al_load_font(font, 0, 0), scale, x, y, color, msg);
+}
+
 /**
- * @brief      Creates a new text element with default font and color
+ * @brief      Creates a new text element with default font and color.
+ *             The font comes out of the binary, never off the disk.
  *
  * @param[in]  scale  The scale
  * @param[in]  x      absolute x coord on screen
@@ -93,7 +158,61 @@ text * text_make_new(const char *font, float scale, float x, float y, ALLEGRO_CO
  * @return     Pointer to new text element
  */
 text * text_make_new_default(float scale, float x, float y, const char *msg) {
-    return text_make_new("fonts/a4_font.tga", scale, x, y, al_map_rgb(255, 255, 255), msg);
+    ALLEGRO_FONT *font = preloaded_font ? preloaded_font : text_load_default_font();
+
+    preloaded_font = NULL;
+    return text_make(font, scale, x, y, al_map_rgb(255, 255, 255), msg);
+}
+
+/**
+ * @brief      Loads the default font ahead of the first text that needs it.
+ *             Safe to run on another thread, as long as it's joined before
+ *             text_make_new_default.
+ */
+void text_preload_default_font() {
+    preloaded_font = text_load_default_font();
+}
+
+/**
+ * @brief      Times loading the default font, embedded and, when the file is
+ *             there, off the disk
+ *
+ * @param[in]  loads  Times to load it
+ */
+void text_benchmark_font(int32 loads) {
+    double start;
+    double embedded;
+    int32 i;
+
+    start = al_get_time();
+    for (i = 0; i < loads; ++i) {
+        al_destroy_font(text_load_default_font());
+    }
+    embedded = al_get_time() - start;
+
+#ifdef WAS_EMBEDDED_FONT
+    printf("Default font (embedded, %u bytes): %.3f ms per load\n",
+           (unsigned)asset_a4_font_size, embedded * 1000.0 / loads);
+#else
+    printf("Default font (builtin, built with WASTEROIDS_EMBED_FONT=OFF): %.3f ms per load\n",
+           embedded * 1000.0 / loads);
+#endif // WAS_EMBEDDED_FONT
+
+    if (!al_filename_exists(DEFAULT_FONT_PATH)) {
+        printf("%s not found, no disk load to compare\n", DEFAULT_FONT_PATH);
+        return;
+    }
+
+    start = al_get_time();
+    for (i = 0; i < loads; ++i) {
+        ALLEGRO_FONT *font = al_load_font(DEFAULT_FONT_PATH, 0, 0);
+
+        if (font) {
+            al_destroy_font(font);
+        }
+    }
+    printf("%s: %.3f ms per load\n", DEFAULT_FONT_PATH,
+           (al_get_time() - start) * 1000.0 / loads);
 }
 
 /**
@@ -128,6 +247,9 @@ void text_draw(text *t) {
     al_identity_transform(&transform);
     al_scale_transform(&transform, t->scale, t->scale);
     al_translate_transform(&transform, 0, 0);
+    if (prevTransform != NULL) {
+        al_compose_transform(&transform, prevTransform);
+    }
     al_use_transform(&transform);
 
     al_draw_text(t->font, al_map_rgb(255, 255, 255), t->x/t->scale, t->y/t->scale, 0, t->msg);
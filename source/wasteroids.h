@@ -50,6 +50,7 @@
 #include <allegro5/allegro_primitives.h>
 #include <allegro5/allegro_font.h>
 #include <allegro5/allegro_image.h>
+#include <allegro5/allegro_memfile.h>
 
 /*=====  End of Allegro  ======*/
 
@@ -89,6 +90,14 @@ typedef uint64_t uint64;
     #define true (0 == 0)
 #endif // true
 
+#if defined(_MSC_VER)
+    #define WAS_THREAD_LOCAL __declspec(thread)
+    #define WAS_ALIGN(n) __declspec(align(n))
+#else
+    #define WAS_THREAD_LOCAL __thread
+    #define WAS_ALIGN(n) __attribute__((aligned(n)))
+#endif // _MSC_VER
+
 /*=====  End of Default datatypes  ======*/
 
 
@@ -98,6 +107,8 @@ typedef uint64_t uint64;
 =============================================*/
 
 // Globals
+// Simulation state is thread local so several games can be stepped
+// at once, one per thread (see BATCH)
 
 /**
  * @brief      screen handler
@@ -107,12 +118,61 @@ extern struct ALLEGRO_DISPLAY *screen;
 /**
  * @brief       key map
  */
-extern bool pressed_keys[ALLEGRO_KEY_MAX];
+extern WAS_THREAD_LOCAL bool pressed_keys[ALLEGRO_KEY_MAX];
 
 /**
  * @brief      holds count of the current score
  */
-extern uint32 score_count;
+extern WAS_THREAD_LOCAL uint32 score_count;
+
+/**
+ * @brief      true once the ship has lost all its lives
+ */
+extern WAS_THREAD_LOCAL bool is_game_over;
+
+/**
+ * @brief      Draw every line one pixel wide, set by the quality governor
+ */
+extern bool render_hairlines;
+
+/**
+ * @brief      Line thickness to draw with, given an object's thickness
+ */
+#define RENDER_THICKNESS(t) (render_hairlines ? 0.0f : (t))
+
+/**
+ * @brief      Seed every random stream of the simulation is keyed by
+ */
+extern WAS_THREAD_LOCAL uint32 sim_rng_seed;
+
+/**
+ * @brief      Number of ticks simulated on the current world
+ */
+extern WAS_THREAD_LOCAL uint32 sim_tick;
+
+/**
+ * @brief      Counter-based random stream, see sim_stream
+ */
+typedef struct {
+    uint64 key;
+    uint64 counter;
+} SimStream;
+
+/**
+ * Size of the simulated world, and its reciprocals for turning positions
+ * into fractions of it. Only world_set_bounds writes it.
+ */
+typedef struct {
+    int32 width;
+    int32 height;
+    float inv_width;
+    float inv_height;
+} WorldBounds;
+
+/**
+ * @brief      Bounds of the simulated world
+ */
+extern WAS_THREAD_LOCAL WorldBounds world_bounds;
 
 /**
  * @brief      Max possible angle
@@ -120,9 +180,42 @@ extern uint32 score_count;
 extern const float MAX_ANGLE;
 
 /**
- * Step for angle change in radians
+ * Ship turn rate in radians per second
+ */
+#define SHIP_TURN_RATE 3.0f
+
+/**
+ * Tick rate the simulation runs at unless told otherwise
+ */
+#define SIM_DEFAULT_TICK_RATE 60
+
+/**
+ * @brief      Simulated seconds per tick. Every speed is per second and gets
+ *             multiplied by this, so the tick rate doesn't change gameplay.
+ */
+extern WAS_THREAD_LOCAL float sim_dt;
+
+/**
+ * Motion of a moving entity, next to its float x and y. The step per tick
+ * is worked out again only when speed or direction change. Fixed-point
+ * builds (WAS_FIXED_POINT) keep the position here as well, on 16.16
+ * fixed-point, and x and y are then just its view for drawing and
+ * collision. Whatever writes x or y directly calls sim_place afterwards.
  */
-#define DIRECTION_STEP 0.05f
+typedef struct {
+    bool stale;
+    float speed;
+    float direction;
+#ifdef WAS_FIXED_POINT
+    int32 x;
+    int32 y;
+    int32 step_x;
+    int32 step_y;
+#else
+    float step_x;
+    float step_y;
+#endif // WAS_FIXED_POINT
+} SimMotion;
 
 
 /*----------  SHIP  ----------*/
@@ -134,19 +227,37 @@ typedef struct {
     float direction;
     float scale;
     float speed;
+    SimMotion motion;
     bool alive;
     ALLEGRO_COLOR color;
     float thickness;
     int8 lives;
     bool can_be_hit;
-    int8 can_be_hit_count;
+    int16 can_be_hit_count;
+    uint8 input;
 } Ship;
 
+/**
+ * Ship input bits, held controls for the next tick
+ */
+#define SHIP_INPUT_LEFT   0x01
+#define SHIP_INPUT_RIGHT  0x02
+#define SHIP_INPUT_THRUST 0x04
+#define SHIP_INPUT_FIRE   0x08
+
 #define SHIP_COLOR al_map_rgb(0, 255, 0)
+#define SHIP2_COLOR al_map_rgb(0, 255, 255)
 #define SHIP_LIVES 3
 
+/**
+ * Seconds a ship can't be hit after being hit, and how fast it blinks meanwhile
+ */
+#define SHIP_INVULNERABLE_TIME 1.0f
+#define SHIP_BLINK_PERIOD (7.0f / 60.0f)
+
 extern const float SHIP_DIMENSION;
-extern Ship *ship;
+extern WAS_THREAD_LOCAL Ship *ship;
+extern WAS_THREAD_LOCAL Ship *ship2;
 
 void ship_init();
 Ship * ship_make_new(float x, float y, float direction, float scale, float speed,
@@ -157,6 +268,7 @@ void ship_get_base_points(Ship *ship, float *x, float *y);
 Ship * ship_delete(Ship *ship);
 void ship_move(Ship *ship);
 int8 ship_hit(Ship *ship);
+float ship_get_late_direction(Ship *ship, uint8 controls, float fraction);
 #endif // WAS_USING_SHIP
 
 
@@ -164,10 +276,36 @@ int8 ship_hit(Ship *ship);
 
 #ifdef WAS_USING_INPUT
 
+/**
+ * Key press or release, as handed over by the input thread
+ */
+typedef struct {
+    bool down;
+    int32 keycode;
+    double timestamp;
+} InputKey;
+
 void input_init();
 void input_shutdown();
 void input_wait_for_event(ALLEGRO_EVENT *ev);
+bool input_get_next_event(ALLEGRO_EVENT *ev);
+bool input_next_key(InputKey *key);
+uint8 input_get_live_controls();
 bool input_is_queue_empty();
+uint8 input_get_controls();
+double input_get_tick_period();
+double input_get_frame_period();
+void input_set_rates(double ticks_per_second, double frames_per_second);
+bool input_is_tick(const ALLEGRO_EVENT *ev);
+bool input_is_frame(const ALLEGRO_EVENT *ev);
+bool input_is_uncapped();
+void input_set_idle(bool on);
+bool input_is_idle();
+void input_probe_enable();
+void input_probe_key(double timestamp, bool needs_tick);
+void input_probe_tick();
+void input_probe_frame_shown();
+void input_probe_report();
 #endif // WAS_USING_INPUT
 
 
@@ -193,6 +331,7 @@ typedef struct {
     float direction;
     float size;
     float speed;
+    SimMotion motion;
     bool alive;
     ALLEGRO_COLOR color;
     float thickness;
@@ -208,8 +347,8 @@ typedef struct {
  */
 #define BLAST_COLOR al_map_rgb(255, 0, 0)
 
-extern Blast *(blasts[BLAST_MAX]);
-extern int32 num_blasts;
+extern WAS_THREAD_LOCAL Blast *(blasts[BLAST_MAX]);
+extern WAS_THREAD_LOCAL int32 num_blasts;
 
 Blast * blast_make_new(float x, float y, float direction, float size, float speed,
                        bool alive, ALLEGRO_COLOR color, float thickness);
@@ -221,6 +360,8 @@ void blast_move_all();
 Blast * blast_delete(Blast *blast);
 void blast_delete_all();
 void blast_get_end_point(Blast *blast, float *x, float *y);
+void blast_get_swept_segment(Blast *blast, float *x1, float *y1, float *x2, float *y2);
+void fire_blast(Ship *shooter);
 #endif // WAS_USING_BLAST
 
 
@@ -230,15 +371,36 @@ void blast_get_end_point(Blast *blast, float *x, float *y);
 #ifdef WAS_USING_ASTEROID
 #define NUM_VERTICES 12
 
+/**
+ * Number of outlines in the shape library
+ */
+#define ASTEROID_SHAPES 16
+
+/**
+ * Outline shared by every asteroid of the same shape. Outlines are star
+ * shaped around the origin, so each convex piece is the fan from the origin
+ * over outline vertices piece_first[k] to piece_first[k + 1] (wrapping
+ * around to vertex 0 for the last piece).
+ */
+typedef struct {
+    float vertices[2 * NUM_VERTICES];
+    float radius;
+    int32 num_pieces;
+    uint8 piece_first[NUM_VERTICES];
+} AsteroidShape;
+
 typedef struct {
     float x;
     float y;
     float direction;
     float scale;
     float speed;
+    SimMotion motion;
     bool alive;
     ALLEGRO_COLOR color;
     float thickness;
+    uint8 shape;
+    uint32 id;
 } Asteroid;
 
 /**
@@ -252,9 +414,9 @@ typedef struct {
 #define ASTEROID_COLOR al_map_rgb(0, 0, 255)
 
 extern const float ASTEROID_DIMENSION;
-extern Asteroid *(asteroids[ASTEROID_MAX]);
-extern int32 num_asteroids;
-extern const float VERTICES[];
+extern WAS_THREAD_LOCAL Asteroid *(asteroids[ASTEROID_MAX]);
+extern WAS_THREAD_LOCAL int32 num_asteroids;
+extern AsteroidShape asteroid_shapes[ASTEROID_SHAPES];
 
 Asteroid * asteroid_make_new(float x, float y, float direction, float scale, float speed,
                              bool alive, ALLEGRO_COLOR color, float thickness);
@@ -270,6 +432,11 @@ void asteroid_populate(int32 n);
 bool asteroid_check_collision_on_blast(Asteroid *asteroid, Blast *blast);
 void asteroid_get_corners(Asteroid *asteroid, float *x1, float *y1, float *x2, float *y2);
 void asteroid_was_hit(Asteroid *asteroid);
+void asteroid_set_max_vertices(int32 n);
+void asteroid_shapes_init();
+void asteroid_sort_spatial();
+bool asteroid_contains_point(Asteroid *asteroid, float x, float y);
+bool asteroid_intersects_segment(Asteroid *asteroid, float x1, float y1, float x2, float y2);
 bool asteroid_check_collision_on_ship(Asteroid *asteroid, Ship *ship);
 #endif // WAS_USING_BLAST
 
@@ -297,9 +464,305 @@ text * text_delete(text *t);
 text * text_make_new(const char *font, float scale, float x, float y, ALLEGRO_COLOR color, const char *msg);
 text * text_make_new_default(float scale, float x, float y, const char *msg);
 void text_update_msg(text *t, const char *msg);
+void text_benchmark_font(int32 loads);
+void text_preload_default_font();
+
+#ifdef WAS_EMBEDDED_FONT
+/**
+ * Default font, embedded at build time (WASTEROIDS_EMBED_FONT)
+ */
+extern const uint8 asset_a4_font[];
+extern const uint32 asset_a4_font_size;
+#endif // WAS_EMBEDDED_FONT
 #endif // WAS_USING_TEXT
 
 
+/*----------  BATCH  ----------*/
+
+#ifdef WAS_USING_BATCH
+/**
+ * Action bits, one byte per game and step
+ */
+#define BATCH_ACTION_LEFT   SHIP_INPUT_LEFT
+#define BATCH_ACTION_RIGHT  SHIP_INPUT_RIGHT
+#define BATCH_ACTION_THRUST SHIP_INPUT_THRUST
+#define BATCH_ACTION_FIRE   SHIP_INPUT_FIRE
+
+/**
+ * Occupancy grid dimensions and cell bits
+ */
+#define BATCH_GRID_WIDTH    32
+#define BATCH_GRID_HEIGHT   24
+#define BATCH_CELL_ASTEROID 0x01
+#define BATCH_CELL_BLAST    0x02
+#define BATCH_CELL_SHIP     0x04
+
+/**
+ * Floats per game on entity observations:
+ * ship (x, y, direction, lives) followed by (x, y, scale) for each asteroid slot
+ */
+#define BATCH_OBS_ENTITIES_LEN (4 + 3 * ASTEROID_MAX)
+
+typedef enum {
+    BATCH_OBS_ENTITIES,
+    BATCH_OBS_GRID
+} BatchObsMode;
+
+typedef struct BatchEnv BatchEnv;
+
+BatchEnv * batch_make_new(int32 num_games, int32 num_threads, int32 width, int32 height,
+                          BatchObsMode mode, uint32 seed);
+BatchEnv * batch_delete(BatchEnv *env);
+int32 batch_get_observation_size(BatchEnv *env);
+void batch_reset(BatchEnv *env, uint32 seed, void *observations);
+void batch_step(BatchEnv *env, const uint8 *actions, void *observations,
+                float *rewards, uint8 *done);
+void batch_benchmark(int32 num_games, int32 num_steps);
+#endif // WAS_USING_BATCH
+
+
+/*----------  AUTOPILOT  ----------*/
+
+#ifdef WAS_USING_AUTOPILOT
+extern bool autopilot_enabled;
+
+void autopilot_update();
+#endif // WAS_USING_AUTOPILOT
+
+
+/*----------  SOAK  ----------*/
+
+#ifdef WAS_USING_SOAK
+/**
+ * Seconds between two soak log lines
+ */
+#define SOAK_LOG_INTERVAL 60.0
+
+void soak_init(double hours);
+void soak_shutdown();
+bool soak_is_running();
+void soak_record_tick(double seconds);
+bool soak_update();
+#endif // WAS_USING_SOAK
+
+
+/*----------  SNAPSHOT  ----------*/
+
+#ifdef WAS_USING_SNAPSHOT
+#define SNAPSHOT_VERSION 7
+
+/**
+ * Header flag: payload is LZ4 block compressed
+ */
+#define SNAPSHOT_COMPRESSED 0x01
+
+/**
+ * Header flag: positions are 16.16 fixed-point, from a WAS_FIXED_POINT build
+ */
+#define SNAPSHOT_FIXED_POINT 0x02
+
+size_t snapshot_get_max_size();
+size_t snapshot_get_capacity();
+size_t snapshot_save(uint8 *buf, size_t capacity, bool compress);
+bool snapshot_load(const uint8 *buf, size_t size);
+bool snapshot_save_file(const char *filename, bool compress);
+bool snapshot_load_file(const char *filename);
+bool snapshot_quick_save();
+bool snapshot_quick_load();
+#endif // WAS_USING_SNAPSHOT
+
+
+/*----------  NETPLAY  ----------*/
+
+#ifdef WAS_USING_NETPLAY
+/**
+ * Ticks of inputs and snapshots kept, which is also the max rollback depth
+ */
+#define NETPLAY_RING 32
+
+void netplay_host(int32 port);
+void netplay_join(const char *address);
+void netplay_set_conditions(int32 latency_ms, int32 loss_percent);
+void netplay_shutdown();
+bool netplay_is_running();
+void netplay_fire();
+bool netplay_update();
+#endif // WAS_USING_NETPLAY
+
+
+/*----------  SPECTATE  ----------*/
+
+#ifdef WAS_USING_SPECTATE
+/**
+ * Max spectator packet size, a full keyframe included
+ */
+#define SPECTATE_PACKET_MAX 1200
+
+void spectate_broadcast_init(int32 port);
+void spectate_join(const char *address);
+void spectate_shutdown();
+bool spectate_is_broadcasting();
+bool spectate_is_viewing();
+void spectate_broadcast();
+bool spectate_update();
+#endif // WAS_USING_SPECTATE
+
+
+/*----------  PARTICLE  ----------*/
+
+#ifdef WAS_USING_PARTICLE
+/**
+ * Particle ring capacity
+ */
+#define PARTICLE_MAX 32768
+
+void particle_set_enabled(bool on);
+bool particle_is_enabled();
+void particle_clear();
+void particle_emit_debris(float x, float y, float scale);
+void particle_emit_thrust(Ship *s);
+void particle_update(float seconds);
+void particle_draw_all();
+bool particle_any_alive();
+void particle_set_draw_limit(int32 n);
+#endif // WAS_USING_PARTICLE
+
+
+/*----------  COLLIDE  ----------*/
+
+#ifdef WAS_USING_COLLIDE
+/**
+ * Boxes tested per step by the widest kernel
+ */
+#define COLLIDE_LANES 8
+#define COLLIDE_CAPACITY ((ASTEROID_MAX + COLLIDE_LANES - 1) / COLLIDE_LANES * COLLIDE_LANES)
+#define COLLIDE_MASK_WORDS ((COLLIDE_CAPACITY + 31) / 32)
+
+/**
+ * Asteroid bounding boxes, one array per corner coordinate
+ */
+typedef struct {
+    WAS_ALIGN(32) float x1[COLLIDE_CAPACITY];
+    WAS_ALIGN(32) float y1[COLLIDE_CAPACITY];
+    WAS_ALIGN(32) float x2[COLLIDE_CAPACITY];
+    WAS_ALIGN(32) float y2[COLLIDE_CAPACITY];
+    int32 n;
+    int32 padded;
+} CollideBounds;
+
+void collide_init();
+const char * collide_get_kernel_name();
+void collide_gather_asteroids(CollideBounds *bounds);
+bool collide_query(const CollideBounds *bounds, float x1, float y1, float x2, float y2,
+                   uint32 *mask);
+int32 collide_next(const uint32 *mask, int32 n, int32 start);
+#endif // WAS_USING_COLLIDE
+
+
+/*----------  FIXED  ----------*/
+
+#ifdef WAS_USING_FIXED
+/**
+ * 16.16 fixed-point number
+ */
+typedef int32 fixed;
+
+#define FIXED_SHIFT 16
+#define FIXED_ONE (1 << FIXED_SHIFT)
+
+/**
+ * Trig table resolution, in steps per turn
+ */
+#define FIXED_TRIG_STEPS 4096
+
+void fixed_init();
+fixed fixed_from_float(float v);
+float fixed_to_float(fixed v);
+fixed fixed_mul(fixed a, fixed b);
+int32 fixed_angle(float radians);
+fixed fixed_sin(int32 step);
+fixed fixed_cos(int32 step);
+#endif // WAS_USING_FIXED
+
+
+/*----------  GOVERNOR  ----------*/
+
+#ifdef WAS_USING_GOVERNOR
+void governor_init();
+bool governor_is_enabled();
+int32 governor_get_level();
+void governor_record_tick(double seconds);
+void governor_record_draw(double seconds);
+#endif // WAS_USING_GOVERNOR
+
+
+/*----------  PACER  ----------*/
+
+#ifdef WAS_USING_PACER
+/**
+ * Lateness histogram buckets
+ */
+#define PACER_BUCKETS 9
+
+typedef struct {
+    uint64 buckets[PACER_BUCKETS];
+    uint64 frames;
+    uint64 skipped;
+    int64 max_late_ns;
+} PacerStats;
+
+void pacer_init(double period, int32 core);
+bool pacer_is_enabled();
+void pacer_wait();
+void pacer_resync();
+const PacerStats * pacer_get_stats();
+int64 pacer_get_bucket_limit_us(int32 bucket);
+void pacer_report();
+#endif // WAS_USING_PACER
+
+
+/*----------  RENDER  ----------*/
+
+#ifdef WAS_USING_RENDER
+/**
+ * Lowest fraction of the display's resolution the scene is drawn at
+ */
+#define RENDER_SCALE_MIN 0.25f
+
+void render_init(float s);
+void render_shutdown();
+void render_resize(int32 width, int32 height);
+float render_get_base_scale();
+float render_get_scale();
+void render_set_scale(float s);
+void render_begin();
+void render_end();
+#endif // WAS_USING_RENDER
+
+
+/*----------  STARTUP  ----------*/
+
+#ifdef WAS_USING_STARTUP
+void startup_begin();
+void startup_run(const char *name, void (*run)());
+void startup_display_ready();
+void startup_wait();
+void startup_enable_report();
+void startup_frame_shown();
+#endif // WAS_USING_STARTUP
+
+
+/*----------  IO  ----------*/
+
+#ifdef WAS_USING_IO
+void io_init();
+void io_shutdown();
+bool io_write_file(const char *path, uint8 *data, size_t size);
+uint8 * io_read_pending(const char *path, size_t *size);
+void io_check_stall();
+#endif // WAS_USING_IO
+
+
 /*=====  End of WAsteroids' specifics  ======*/
 
 
@@ -394,22 +857,158 @@ bool common_check_collision(float x, float y, float corner_x1, float corner_y1,
                             float corner_x2, float corner_y2);
 
 /**
- * @brief      Checks for collision between blasts and asteroids
+ * @brief      Finds hits between blasts and asteroids and queues them for
+ *             resolve_collisions. Each blast and each asteroid takes part
+ *             in at most one hit.
  */
 void check_blasts_on_asteroids();
 
 
 /**
- * @brief      Checks for collision between ship and asteroids
+ * @brief      Finds hits between ships and asteroids and queues them for
+ *             resolve_collisions
  */
 void check_ship_on_asteroids();
 
 
+/**
+ * @brief      Applies the queued hits: splits, deletions, lives, scoring,
+ *             and the score text once at the end
+ */
+void resolve_collisions();
+
+
 /**
  * @brief      Finishes game
  */
 void game_over();
 
+
+/**
+ * @brief      Sets up a new game on the current world
+ */
+void game_start();
+
+
+/**
+ * @brief      Frees every game object of the current world
+ */
+void game_end();
+
+
+/**
+ * @brief      Shows the current score on the score text
+ */
+void update_score_text();
+
+
+/**
+ * @brief      Throws the current game away and starts a new one
+ */
+void game_restart();
+
+
+/**
+ * @brief      Runs one simulation tick: movement, collisions and timers
+ */
+void game_tick();
+
+
+/**
+ * @brief      Sets the size of the simulated world
+ *
+ * @param[in]  width   The width
+ * @param[in]  height  The height
+ */
+void world_set_bounds(int32 width, int32 height);
+
+
+/**
+ * @brief      Seeds the simulation's random number generator
+ *
+ * @param[in]  seed  The seed
+ */
+void sim_seed(uint32 seed);
+
+
+/**
+ * @brief      Opens the random stream of an entity for the current tick.
+ *             Streams are keyed by seed, tick and entity ID, so what an
+ *             entity draws doesn't depend on what other entities drew
+ *             before it, or on which thread runs first.
+ *
+ * @param[in]  entity  Entity ID, 0 for the world itself
+ *
+ * @return     The stream
+ */
+SimStream sim_stream(uint32 entity);
+
+
+/**
+ * @brief      Draws the next number from a random stream
+ *
+ * @param      stream  The stream
+ *
+ * @return     Random number in [0, 2^32)
+ */
+uint32 sim_stream_next(SimStream *stream);
+
+
+/**
+ * @brief      Derives the ID of an entity spawned by another
+ *
+ * @param[in]  parent  Spawning entity's ID
+ * @param[in]  n       Which of its spawns this is
+ *
+ * @return     The new ID
+ */
+uint32 sim_child_id(uint32 parent, uint32 n);
+
+
+/**
+ * @brief      Cosine as seen by the simulation. Table-based on fixed-point
+ *             builds (WAS_FIXED_POINT), so it's the same everywhere.
+ *
+ * @param[in]  radians  The angle
+ *
+ * @return     Cosine
+ */
+float sim_cos(float radians);
+
+
+/**
+ * @brief      Sine as seen by the simulation, see sim_cos
+ *
+ * @param[in]  radians  The angle
+ *
+ * @return     Sine
+ */
+float sim_sin(float radians);
+
+
+/**
+ * @brief      Puts an entity where its float x and y say. Also makes the
+ *             next sim_advance work its step out again.
+ *
+ * @param      motion  The entity's motion
+ * @param[in]  x       x-coordinate
+ * @param[in]  y       y-coordinate
+ */
+void sim_place(SimMotion *motion, float x, float y);
+
+
+/**
+ * @brief      Moves an entity one tick along a direction, on 16.16
+ *             fixed-point on fixed-point builds
+ *
+ * @param      motion     The entity's motion
+ * @param      x          x-coordinate, updated
+ * @param      y          y-coordinate, updated
+ * @param[in]  speed      Distance to move
+ * @param[in]  direction  Direction, counterclockwise from the x-axis
+ */
+void sim_advance(SimMotion *motion, float *x, float *y, float speed, float direction);
+
 /*=====  End of Common function prototypes  ======*/
 
 #ifdef __cplusplus